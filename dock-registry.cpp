@@ -0,0 +1,142 @@
+#include "dock-registry.hpp"
+
+DockRegistry::~DockRegistry()
+{
+	Clear();
+}
+
+void DockRegistry::Reindex(size_t from)
+{
+	for (size_t i = from; i < entries.size(); i++) {
+		nameIndex[entries[i].name] = i;
+		handleIndex[entries[i].handle] = i;
+	}
+}
+
+uint32_t DockRegistry::Add(const char *name, DownstreamKeyerDock *dock, obs_view_t *view, obs_canvas_t *canvas)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = nameIndex.find(name);
+	if (it != nameIndex.end()) {
+		auto &entry = entries[it->second];
+		entry.dock = dock;
+		entry.view = view;
+		obs_weak_canvas_release(entry.canvas);
+		entry.canvas = canvas ? obs_canvas_get_weak_canvas(canvas) : nullptr;
+		generation++;
+		return entry.handle;
+	}
+	// handles are never reused, so a handle held past removal stays invalid instead of pointing at another dock
+	const uint32_t handle = ++nextHandle;
+	entries.push_back({name, handle, dock, view, canvas ? obs_canvas_get_weak_canvas(canvas) : nullptr});
+	Reindex(entries.size() - 1);
+	generation++;
+	return handle;
+}
+
+void DockRegistry::Erase(size_t idx)
+{
+	nameIndex.erase(entries[idx].name);
+	handleIndex.erase(entries[idx].handle);
+	obs_weak_canvas_release(entries[idx].canvas);
+	// keep the insertion order, it is the order views are listed in the output source properties
+	entries.erase(entries.begin() + (std::ptrdiff_t)idx);
+	Reindex(idx);
+	generation++;
+}
+
+bool DockRegistry::Remove(const char *name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = nameIndex.find(name);
+	if (it == nameIndex.end())
+		return false;
+	Erase(it->second);
+	return true;
+}
+
+bool DockRegistry::RemoveDock(DownstreamKeyerDock *dock)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].dock == dock) {
+			Erase(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+void DockRegistry::Clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto &entry : entries)
+		obs_weak_canvas_release(entry.canvas);
+	entries.clear();
+	nameIndex.clear();
+	handleIndex.clear();
+	generation++;
+}
+
+DownstreamKeyerDock *DockRegistry::Find(const char *name) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = nameIndex.find(name ? name : "");
+	return it == nameIndex.end() ? nullptr : entries[it->second].dock;
+}
+
+uint32_t DockRegistry::FindHandle(const char *name) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = nameIndex.find(name ? name : "");
+	return it == nameIndex.end() ? 0 : entries[it->second].handle;
+}
+
+size_t DockRegistry::Count() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+// a copy, the entry can be removed as soon as the lock is released
+std::string DockRegistry::GetName(size_t idx) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return idx < entries.size() ? entries[idx].name : std::string();
+}
+
+obs_view_t *DockRegistry::GetView(const char *name) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = nameIndex.find(name ? name : "");
+	return it == nameIndex.end() ? nullptr : entries[it->second].view;
+}
+
+obs_canvas_t *DockRegistry::GetCanvas(const char *name) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = nameIndex.find(name ? name : "");
+	return it == nameIndex.end() ? nullptr : obs_weak_canvas_get_canvas(entries[it->second].canvas);
+}
+
+obs_source_t *DockRegistry::GetChannelSource(uint32_t handle, uint32_t channel) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = handleIndex.find(handle);
+	if (it == handleIndex.end())
+		return nullptr;
+	const auto &entry = entries[it->second];
+	if (entry.view)
+		return obs_view_get_source(entry.view, channel);
+	obs_canvas_t *canvas = obs_weak_canvas_get_canvas(entry.canvas);
+	if (!canvas)
+		return nullptr;
+	obs_source_t *source = obs_canvas_get_channel(canvas, channel);
+	obs_canvas_release(canvas);
+	return source;
+}
+
+uint64_t DockRegistry::Generation() const
+{
+	return generation;
+}
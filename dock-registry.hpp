@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <obs.h>
+
+class DownstreamKeyerDock;
+
+struct dock_registry_entry {
+	std::string name;
+	uint32_t handle;
+	DownstreamKeyerDock *dock;
+	obs_view_t *view;
+	obs_weak_canvas_t *canvas;
+};
+
+// Docks by view or canvas name, stored densely with name and handle indexes.
+// Docks are added, removed and iterated on the UI thread, the video thread only resolves handles to channel sources.
+class DockRegistry {
+private:
+	std::vector<dock_registry_entry> entries;
+	std::unordered_map<std::string, size_t> nameIndex;
+	std::unordered_map<uint32_t, size_t> handleIndex;
+	uint32_t nextHandle = 0;
+	std::atomic<uint64_t> generation = 0;
+	mutable std::mutex mutex;
+
+	void Reindex(size_t from);
+	void Erase(size_t idx);
+
+public:
+	~DockRegistry();
+
+	uint32_t Add(const char *name, DownstreamKeyerDock *dock, obs_view_t *view, obs_canvas_t *canvas);
+	bool Remove(const char *name);
+	bool RemoveDock(DownstreamKeyerDock *dock);
+	void Clear();
+
+	DownstreamKeyerDock *Find(const char *name) const;
+	uint32_t FindHandle(const char *name) const;
+	size_t Count() const;
+	std::string GetName(size_t idx) const;
+	obs_view_t *GetView(const char *name) const;
+	obs_canvas_t *GetCanvas(const char *name) const;
+	obs_source_t *GetChannelSource(uint32_t handle, uint32_t channel) const;
+	uint64_t Generation() const;
+
+	std::vector<dock_registry_entry>::const_iterator begin() const { return entries.begin(); }
+	std::vector<dock_registry_entry>::const_iterator end() const { return entries.end(); }
+};
@@ -1,15 +1,29 @@
 #include "downstream-keyer.hpp"
 #include "downstream-keyer-dock.hpp"
+#include "dock-registry.hpp"
+#include "ipc-server.hpp"
+#include "state-export.hpp"
 #include "name-dialog.hpp"
 #include "obs.hpp"
 #include "obs-websocket-api.h"
 #include "version.h"
 #include <obs-module.h>
+#include <QApplication>
+#include <QInputDialog>
+#include <QLineEdit>
 #include <QMainWindow>
 #include <QMenu>
 #include <QPushButton>
+#include <QThread>
 #include <QVBoxLayout>
 #include <QWidgetAction>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <util/bmem.h>
 #include <util/platform.h>
 
 #ifndef _WIN32
@@ -24,74 +38,125 @@ OBS_MODULE_AUTHOR("Exeldro");
 OBS_MODULE_USE_DEFAULT_LOCALE("downstream-keyer", "en-US")
 
 MODULE_EXTERN struct obs_source_info output_source_info;
+MODULE_EXTERN struct obs_source_info static_cache_source_info;
 
-std::map<std::string, DownstreamKeyerDock *> _dsks;
+DockRegistry _dsks;
 obs_websocket_vendor vendor = nullptr;
 
 extern "C" {
 size_t get_view_count();
-const char *get_view_name(size_t idx);
+char *get_view_name(size_t idx);
+uint32_t get_view_handle(const char *view_name);
+uint64_t get_view_generation();
 obs_view_t *get_view_by_name(const char *view_name);
 obs_canvas_t *get_canvas_by_name(const char *view_name);
-obs_source_t *get_source_from_view(const char *view_name, uint32_t channel);
+obs_source_t *get_source_from_view(uint32_t view_handle, uint32_t channel);
 };
 
 size_t get_view_count()
 {
-	return _dsks.size();
+	return _dsks.Count();
 }
 
-const char *get_view_name(size_t idx)
+// the caller frees the name with bfree
+char *get_view_name(size_t idx)
 {
-	size_t i = 0;
-	for (auto it = _dsks.begin(); it != _dsks.end(); it++) {
-		if (i == idx) {
-			return it->first.c_str();
-		}
-		i++;
-	}
-	return NULL;
+	return bstrdup(_dsks.GetName(idx).c_str());
+}
+
+uint32_t get_view_handle(const char *view_name)
+{
+	return _dsks.FindHandle(view_name);
+}
+
+uint64_t get_view_generation()
+{
+	return _dsks.Generation();
 }
 
 obs_view_t *get_view_by_name(const char *view_name)
 {
-	auto it = _dsks.find(view_name);
-	if (it == _dsks.end())
-		return NULL;
-	obs_view_t *view = it->second->GetView();
-	return view;
+	return _dsks.GetView(view_name);
 }
 
 obs_canvas_t *get_canvas_by_name(const char *view_name)
 {
-	auto it = _dsks.find(view_name);
-	if (it == _dsks.end())
-		return NULL;
-	obs_canvas_t *canvas = it->second->GetCanvas();
-	return canvas;
-}
-
-obs_source_t *get_source_from_view(const char *view_name, uint32_t channel)
-{
-	obs_source_t *source = nullptr;
-	auto it = _dsks.find(view_name);
-	if (it != _dsks.end()) {
-		obs_view_t *view = it->second->GetView();
-		if (view) {
-			source = obs_view_get_source(view, channel);
-		} else {
-			obs_canvas_t *canvas = it->second->GetCanvas();
-			if (canvas) {
-				source = obs_canvas_get_channel(canvas, channel);
-				obs_canvas_release(canvas);
-			}
-		}
-	}
-	return source;
+	return _dsks.GetCanvas(view_name);
+}
+
+obs_source_t *get_source_from_view(uint32_t view_handle, uint32_t channel)
+{
+	return _dsks.GetChannelSource(view_handle, channel);
 }
 
 obs_data_t *load_data = nullptr;
 
+static std::atomic<bool> state_publish_pending = false;
+// per keyer GetState() results, dsk_query answers from these instead of walking the docks and rebuilds them once after a change
+static std::vector<obs_data_t *> state_snapshot;
+static std::atomic<bool> state_snapshot_dirty = true;
+
+static void ReleaseStateSnapshot()
+{
+	for (auto state : state_snapshot)
+		obs_data_release(state);
+	state_snapshot.clear();
+}
+
+// set on frontend exit and unload, from then on other threads no longer wait for the UI thread
+static std::atomic<bool> ui_calls_closed = false;
+
+struct ui_call {
+	std::mutex mutex;
+	std::condition_variable done_cv;
+	bool running = false;
+	bool done = false;
+	bool cancelled = false;
+};
+
+// keyers live on the UI thread, procs and vendor requests can be called from any thread.
+// The wait is bounded: a UI thread that is itself waiting on the caller (shutdown, unload) makes this time out
+// instead of deadlocking. A call that already started is always waited for, since it uses the caller's data.
+static bool run_on_ui_thread(const std::function<void()> &f)
+{
+	if (QThread::currentThread() == qApp->thread()) {
+		f();
+		return true;
+	}
+	if (ui_calls_closed)
+		return false;
+	// the UI thread can be waiting on the graphics or audio thread itself, waiting on it from there stalls output
+	if (obs_in_task_thread(OBS_TASK_GRAPHICS) || obs_in_task_thread(OBS_TASK_AUDIO)) {
+		blog(LOG_ERROR, "[Downstream Keyer] keyer procs and requests can not be called from the graphics or audio thread");
+		return false;
+	}
+	auto call = std::make_shared<ui_call>();
+	QMetaObject::invokeMethod(
+		qApp,
+		[call, f]() {
+			{
+				std::lock_guard<std::mutex> lock(call->mutex);
+				if (call->cancelled)
+					return;
+				call->running = true;
+			}
+			f();
+			std::lock_guard<std::mutex> lock(call->mutex);
+			call->done = true;
+			call->done_cv.notify_all();
+		},
+		Qt::QueuedConnection);
+	std::unique_lock<std::mutex> lock(call->mutex);
+	if (call->done_cv.wait_for(lock, std::chrono::seconds(5), [&call]() { return call->done; }))
+		return true;
+	if (call->running) {
+		call->done_cv.wait(lock, [&call]() { return call->done; });
+		return true;
+	}
+	call->cancelled = true;
+	return false;
+}
+
 static DownstreamKeyerDock *add_dock(const char *viewName, obs_view_t *view, obs_canvas_t *canvas)
 {
 	const auto main_window = static_cast<QMainWindow *>(obs_frontend_get_main_window());
@@ -104,7 +169,7 @@ static DownstreamKeyerDock *add_dock(const char *viewName, obs_view_t *view, obs
 	name += "DownstreamKeyerDock";
 
 	obs_frontend_add_dock_by_id(QT_TO_UTF8(name), QT_TO_UTF8(title), dsk);
-	_dsks[viewName] = dsk;
+	_dsks.Add(viewName, dsk, view, canvas);
 	obs_frontend_pop_ui_translation();
 	if (load_data)
 		DownstreamKeyerDock::frontend_save_load(load_data, false, dsk);
@@ -118,11 +183,11 @@ static void proc_add_view(void *data, calldata_t *cd)
 	obs_view_t *view = (obs_view_t *)calldata_ptr(cd, "view");
 	if (!viewName || !strlen(viewName))
 		return;
-	auto dski = _dsks.find(viewName);
-	if (dski != _dsks.end()) {
+	auto dski = _dsks.Find(viewName);
+	if (dski) {
 		auto transitions = (get_transitions_callback_t)calldata_ptr(cd, "get_transitions");
 		if (transitions) {
-			dski->second->SetTransitions((get_transitions_callback_t)calldata_ptr(cd, "get_transitions"),
+			dski->SetTransitions((get_transitions_callback_t)calldata_ptr(cd, "get_transitions"),
 						     calldata_ptr(cd, "get_transitions_data"));
 		}
 		return;
@@ -140,11 +205,11 @@ static void proc_add_canvas(void *data, calldata_t *cd)
 	obs_canvas_t *canvas = (obs_canvas_t *)calldata_ptr(cd, "canvas");
 	if (!viewName || !strlen(viewName))
 		return;
-	auto dski = _dsks.find(viewName);
-	if (dski != _dsks.end()) {
+	auto dski = _dsks.Find(viewName);
+	if (dski) {
 		auto transitions = (get_transitions_callback_t)calldata_ptr(cd, "get_transitions");
 		if (transitions) {
-			dski->second->SetTransitions((get_transitions_callback_t)calldata_ptr(cd, "get_transitions"),
+			dski->SetTransitions((get_transitions_callback_t)calldata_ptr(cd, "get_transitions"),
 						     calldata_ptr(cd, "get_transitions_data"));
 		}
 		return;
@@ -161,13 +226,13 @@ static void proc_remove_view(void *data, calldata_t *cd)
 	const char *viewName = calldata_string(cd, "view_name");
 	if (!viewName || !strlen(viewName))
 		return;
-	if (_dsks.find(viewName) == _dsks.end()) {
+	// drop the registry entry first so the video thread stops resolving the dock before it is deleted
+	if (!_dsks.Remove(viewName)) {
 		return;
 	}
 	std::string name = viewName;
 	name += "DownstreamKeyerDock";
 	obs_frontend_remove_dock(name.c_str());
-	_dsks.erase(viewName);
 }
 
 static void proc_remove_canvas(void *data, calldata_t *cd)
@@ -176,13 +241,13 @@ static void proc_remove_canvas(void *data, calldata_t *cd)
 	const char *viewName = calldata_string(cd, "canvas_name");
 	if (!viewName || !strlen(viewName))
 		return;
-	if (_dsks.find(viewName) == _dsks.end()) {
+	// drop the registry entry first so the video thread stops resolving the dock before it is deleted
+	if (!_dsks.Remove(viewName)) {
 		return;
 	}
 	std::string name = viewName;
 	name += "DownstreamKeyerDock";
 	obs_frontend_remove_dock(name.c_str());
-	_dsks.erase(viewName);
 }
 
 static void refresh_canvas()
@@ -196,7 +261,7 @@ static void refresh_canvas()
 			const char *canvas_name = obs_canvas_get_name(canvas);
 			if (!canvas_name || !strlen(canvas_name))
 				return true;
-			if (_dsks.find(canvas_name) != _dsks.end())
+			if (_dsks.Find(canvas_name))
 				return true;
 			add_dock(canvas_name, nullptr, canvas);
 			return true;
@@ -213,6 +278,11 @@ static void frontend_event(enum obs_frontend_event event, void *data)
 	} else if (event == OBS_FRONTEND_EVENT_CANVAS_REMOVED) {
 	} else if (event == OBS_FRONTEND_EVENT_SCENE_COLLECTION_CLEANUP) {
 		load_data = nullptr;
+		ClearActiveScenes();
+	} else if (event == OBS_FRONTEND_EVENT_SCENE_CHANGED) {
+		InvalidateActiveScenes();
+	} else if (event == OBS_FRONTEND_EVENT_EXIT) {
+		ui_calls_closed = true;
 	}
 }
 
@@ -228,6 +298,8 @@ bool obs_module_load()
 {
 	blog(LOG_INFO, "[Downstream Keyer] loaded version %s", PROJECT_VERSION);
 	obs_register_source(&output_source_info);
+	obs_register_source(&static_cache_source_info);
+	OpenStateExport();
 
 	const auto main_window = static_cast<QMainWindow *>(obs_frontend_get_main_window());
 	obs_frontend_push_ui_translation(obs_module_get_string);
@@ -235,59 +307,102 @@ bool obs_module_load()
 	auto dsk = new DownstreamKeyerDock(main_window);
 
 	obs_frontend_add_dock_by_id("DownstreamKeyerDock", obs_module_text("DownstreamKeyer"), dsk);
-	_dsks[""] = dsk;
+	_dsks.Add("", dsk, nullptr, nullptr);
 	obs_frontend_pop_ui_translation();
 	auto ph = obs_get_proc_handler();
+	// the keyer procs run on the UI thread and wait for it, calls from the graphics or audio thread fail with success false
 	proc_handler_add(ph, "void downstream_keyer_add_view(in ptr view, in string view_name)", &proc_add_view, nullptr);
 	proc_handler_add(ph, "void downstream_keyer_remove_view(in string view_name)", &proc_remove_view, nullptr);
 	proc_handler_add(ph, "void downstream_keyer_add_canvas(in ptr canvas, in string canvas_name)", &proc_add_canvas, nullptr);
 	proc_handler_add(ph, "void downstream_keyer_remove_canvas(in string canvas_name)", &proc_remove_canvas, nullptr);
+	proc_handler_add(ph,
+			 "void downstream_keyer_select_scene(in string view_name, in string dsk_name, in string scene, out bool success)",
+			 &DownstreamKeyerDock::proc_select_scene, nullptr);
+	proc_handler_add(ph, "void downstream_keyer_cue_scene(in string view_name, in string dsk_name, in string scene, out bool success)",
+			 &DownstreamKeyerDock::proc_cue_scene, nullptr);
+	proc_handler_add(ph, "void downstream_keyer_take(in string view_name, in string dsk_name, out bool success)",
+			 &DownstreamKeyerDock::proc_take, nullptr);
+	proc_handler_add(ph, "void downstream_keyer_set_tie(in string view_name, in string dsk_name, in bool tie, out bool success)",
+			 &DownstreamKeyerDock::proc_set_tie, nullptr);
+	proc_handler_add(ph,
+			 "void downstream_keyer_set_transition(in string view_name, in string dsk_name, in string transition, "
+			 "in int duration, in string transition_type, out bool success)",
+			 &DownstreamKeyerDock::proc_set_transition, nullptr);
+	proc_handler_add(ph,
+			 "void downstream_keyer_get_state(in string view_name, in string dsk_name, out string scene, "
+			 "out string cued_scene, out int channel, out bool tie, out bool rendering, out string transition_phase, "
+			 "out float transition_progress, out bool transitions_ready, out bool success)",
+			 &DownstreamKeyerDock::proc_get_state, nullptr);
 
 	obs_frontend_add_event_callback(frontend_event, nullptr);
 	obs_frontend_add_save_callback(frontend_save_load, nullptr);
 	return true;
 }
 
+struct vendor_request {
+	const char *name;
+	obs_websocket_request_callback_function callback;
+};
+
+static const vendor_request vendor_requests[] = {
+	{"get_downstream_keyers", DownstreamKeyerDock::get_downstream_keyers},
+	{"get_downstream_keyer", DownstreamKeyerDock::get_downstream_keyer},
+	{"add_downstream_keyer", DownstreamKeyerDock::add_downstream_keyer},
+	{"remove_downstream_keyer", DownstreamKeyerDock::remove_downstream_keyer},
+	{"dsk_get_scene", DownstreamKeyerDock::get_scene},
+	{"dsk_select_scene", DownstreamKeyerDock::change_scene},
+	{"dsk_cue_scene", DownstreamKeyerDock::cue_scene},
+	{"dsk_take", DownstreamKeyerDock::take},
+	{"dsk_get_state", DownstreamKeyerDock::get_state},
+	{"dsk_query", DownstreamKeyerDock::query},
+	{"dsk_subscribe", DownstreamKeyerDock::subscribe},
+	{"dsk_unsubscribe", DownstreamKeyerDock::unsubscribe},
+	{"dsk_set_event_coalescing", DownstreamKeyerDock::set_event_coalescing},
+	{"dsk_add_scene", DownstreamKeyerDock::add_scene},
+	{"dsk_remove_scene", DownstreamKeyerDock::remove_scene},
+	{"dsk_set_scenes", DownstreamKeyerDock::set_scenes},
+	{"dsk_set_tie", DownstreamKeyerDock::set_tie},
+	{"dsk_set_transition", DownstreamKeyerDock::set_transition},
+	{"dsk_add_exclude_scene", DownstreamKeyerDock::add_exclude_scene},
+	{"dsk_remove_exclude_scene", DownstreamKeyerDock::remove_exclude_scene},
+	{"dsk_add_exclude_rule", DownstreamKeyerDock::add_exclude_rule},
+	{"dsk_remove_exclude_rule", DownstreamKeyerDock::remove_exclude_rule},
+};
+
+// obs-websocket calls vendor requests from its own worker threads, run them on the UI thread that owns the keyers
+static void vendor_request_ui_thread(obs_data_t *request_data, obs_data_t *response_data, void *param)
+{
+	const auto request = static_cast<const vendor_request *>(param);
+	if (!run_on_ui_thread([request, request_data, response_data]() { request->callback(request_data, response_data, nullptr); })) {
+		obs_data_set_string(response_data, "error", "UI thread unavailable");
+		obs_data_set_bool(response_data, "success", false);
+	}
+}
+
 void obs_module_post_load(void)
 {
 	vendor = obs_websocket_register_vendor("downstream-keyer");
 	if (!vendor)
 		return;
-	obs_websocket_vendor_register_request(vendor, "get_downstream_keyers", DownstreamKeyerDock::get_downstream_keyers, nullptr);
-	obs_websocket_vendor_register_request(vendor, "get_downstream_keyer", DownstreamKeyerDock::get_downstream_keyer, nullptr);
-	obs_websocket_vendor_register_request(vendor, "add_downstream_keyer", DownstreamKeyerDock::add_downstream_keyer, nullptr);
-	obs_websocket_vendor_register_request(vendor, "remove_downstream_keyer", DownstreamKeyerDock::remove_downstream_keyer,
-					      nullptr);
-	obs_websocket_vendor_register_request(vendor, "dsk_get_scene", DownstreamKeyerDock::get_scene, nullptr);
-	obs_websocket_vendor_register_request(vendor, "dsk_select_scene", DownstreamKeyerDock::change_scene, nullptr);
-	obs_websocket_vendor_register_request(vendor, "dsk_add_scene", DownstreamKeyerDock::add_scene, nullptr);
-	obs_websocket_vendor_register_request(vendor, "dsk_remove_scene", DownstreamKeyerDock::remove_scene, nullptr);
-	obs_websocket_vendor_register_request(vendor, "dsk_set_tie", DownstreamKeyerDock::set_tie, nullptr);
-	obs_websocket_vendor_register_request(vendor, "dsk_set_transition", DownstreamKeyerDock::set_transition, nullptr);
-	obs_websocket_vendor_register_request(vendor, "dsk_add_exclude_scene", DownstreamKeyerDock::add_exclude_scene, nullptr);
-	obs_websocket_vendor_register_request(vendor, "dsk_remove_exclude_scene", DownstreamKeyerDock::remove_exclude_scene,
-					      nullptr);
+	for (const auto &request : vendor_requests)
+		obs_websocket_vendor_register_request(vendor, request.name, vendor_request_ui_thread, (void *)&request);
 }
 
 void obs_module_unload()
 {
+	ui_calls_closed = true;
 	obs_frontend_remove_event_callback(frontend_event, nullptr);
 	obs_frontend_remove_save_callback(frontend_save_load, nullptr);
-	_dsks.clear();
+	StopLocalControl();
+	CloseStateExport();
+	ReleaseStateSnapshot();
+	_dsks.Clear();
+	ClearActiveScenes();
 	obs_frontend_remove_dock("DownstreamKeyerDock");
 	if (!vendor || !obs_get_module("obs-websocket"))
 		return;
-	obs_websocket_vendor_unregister_request(vendor, "get_downstream_keyers");
-	obs_websocket_vendor_unregister_request(vendor, "get_downstream_keyer");
-	obs_websocket_vendor_unregister_request(vendor, "add_downstream_keyer");
-	obs_websocket_vendor_unregister_request(vendor, "remove_downstream_keyer");
-	obs_websocket_vendor_unregister_request(vendor, "dsk_select_scene");
-	obs_websocket_vendor_unregister_request(vendor, "dsk_add_scene");
-	obs_websocket_vendor_unregister_request(vendor, "dsk_remove_scene");
-	obs_websocket_vendor_unregister_request(vendor, "dsk_set_tie");
-	obs_websocket_vendor_unregister_request(vendor, "dsk_set_transition");
-	obs_websocket_vendor_unregister_request(vendor, "dsk_add_exclude_scene");
-	obs_websocket_vendor_unregister_request(vendor, "dsk_remove_exclude_scene");
+	for (const auto &request : vendor_requests)
+		obs_websocket_vendor_unregister_request(vendor, request.name);
 }
 
 MODULE_EXPORT const char *obs_module_description(void)
@@ -303,12 +418,29 @@ MODULE_EXPORT const char *obs_module_name(void)
 void DownstreamKeyerDock::frontend_save_load(obs_data_t *save_data, bool saving, void *data)
 {
 	auto downstreamKeyerDock = static_cast<DownstreamKeyerDock *>(data);
+#ifdef DSK_PROFILE_SAVE_LOAD
+	const uint64_t start = os_gettime_ns();
+	const long outstanding = bnum_allocs();
+#endif
 	if (saving) {
 		downstreamKeyerDock->Save(save_data);
 	} else {
 		downstreamKeyerDock->Load(save_data);
 		downstreamKeyerDock->loaded = true;
 	}
+#ifdef DSK_PROFILE_SAVE_LOAD
+	// bnum_allocs is the process wide number of outstanding bmem allocations, other threads change it too
+	int scenes = 0;
+	const int count = downstreamKeyerDock->tabs->count();
+	for (int i = 0; i < count; i++) {
+		auto w = dynamic_cast<DownstreamKeyer *>(downstreamKeyerDock->tabs->widget(i));
+		if (w)
+			scenes += w->GetSceneCount();
+	}
+	blog(LOG_INFO, "[Downstream Keyer] %s '%s' with %d keyers and %d scenes took %.3f ms, outstanding bmem allocations %+ld",
+	     saving ? "saved" : "loaded", downstreamKeyerDock->viewName.c_str(), count, scenes,
+	     (double)(os_gettime_ns() - start) / 1000000.0, bnum_allocs() - outstanding);
+#endif
 }
 
 void DownstreamKeyerDock::frontend_event(enum obs_frontend_event event, void *data)
@@ -320,8 +452,9 @@ void DownstreamKeyerDock::frontend_event(enum obs_frontend_event event, void *da
 			downstreamKeyerDock->AddDefaultKeyer();
 	} else if (event == OBS_FRONTEND_EVENT_EXIT) {
 		downstreamKeyerDock->ClearKeyers();
-	} else if (event == OBS_FRONTEND_EVENT_SCENE_CHANGED) {
-		QMetaObject::invokeMethod(downstreamKeyerDock, "SceneChanged", Qt::QueuedConnection);
+	} else if (event == OBS_FRONTEND_EVENT_SCENE_CHANGED && !downstreamKeyerDock->canvas) {
+		// canvas docks follow their own channel 0 through canvas_channel_change
+		downstreamKeyerDock->QueueSceneChanged();
 	} else if (event == OBS_FRONTEND_EVENT_SCRIPTING_SHUTDOWN) {
 		downstreamKeyerDock->closing = true;
 		downstreamKeyerDock->ClearKeyers();
@@ -348,24 +481,28 @@ DownstreamKeyerDock::DownstreamKeyerDock(QWidget *parent, int oc, obs_view_t *v,
 		signal_handler_connect(
 			sh, "remove",
 			[](void *data, calldata_t *cd) {
-				UNUSED_PARAMETER(cd);
+				InvalidateActiveScene(calldata_ptr(cd, "canvas"));
 				auto dock = static_cast<DownstreamKeyerDock *>(data);
 				dock->closing = true;
+				// unregister right away, the registry is walked by state publishing before deleteLater runs
+				_dsks.RemoveDock(dock);
 				dock->ClearKeyers();
 				dock->deleteLater();
 			},
 			this);
+		signal_handler_connect(sh, "channel_change", canvas_channel_change, this);
+		WatchChannelTransition();
 	}
 
 	tabs = new QTabWidget(this);
 	tabs->setMovable(true);
 
-	connect(tabs->tabBar(), &QTabBar::tabMoved, tabs->tabBar(), [this]() {
-		int count = tabs->count();
-		for (int i = 0; i < count; i++) {
-			auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
-			w->SetOutputChannel(outputChannel + i);
-		}
+	connect(tabs->tabBar(), &QTabBar::tabMoved, this, &DownstreamKeyerDock::RestackComposite);
+
+	connect(tabs, &QTabWidget::currentChanged, [this](int index) {
+		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(index));
+		if (w)
+			w->Materialize();
 	});
 
 	auto config = new QPushButton(this);
@@ -389,14 +526,81 @@ DownstreamKeyerDock::~DownstreamKeyerDock()
 
 	obs_frontend_remove_save_callback(frontend_save_load, this);
 	obs_frontend_remove_event_callback(frontend_event, this);
+	_dsks.RemoveDock(this);
 	ClearKeyers();
+	obs_canvas_t *c = obs_weak_canvas_get_canvas(canvas);
+	if (c) {
+		signal_handler_disconnect(obs_canvas_get_signal_handler(c), "channel_change", canvas_channel_change, this);
+		obs_canvas_release(c);
+	}
+	obs_source_t *t = obs_weak_source_get_source(channelTransition);
+	if (t) {
+		signal_handler_disconnect(obs_source_get_signal_handler(t), "transition_start", channel_transition_start, this);
+		obs_source_release(t);
+	}
+	obs_weak_source_release(channelTransition);
 	obs_weak_canvas_release(canvas);
 }
 
+void DownstreamKeyerDock::canvas_channel_change(void *data, calldata_t *cd)
+{
+	if (calldata_int(cd, "channel") != 0)
+		return;
+	auto dock = static_cast<DownstreamKeyerDock *>(data);
+	obs_canvas_t *c = obs_weak_canvas_get_canvas(dock->canvas);
+	InvalidateActiveScene(c);
+	obs_canvas_release(c);
+	QMetaObject::invokeMethod(dock, "ChannelChanged", Qt::QueuedConnection);
+}
+
+void DownstreamKeyerDock::channel_transition_start(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	auto dock = static_cast<DownstreamKeyerDock *>(data);
+	obs_canvas_t *c = obs_weak_canvas_get_canvas(dock->canvas);
+	InvalidateActiveScene(c);
+	obs_canvas_release(c);
+	dock->QueueSceneChanged();
+}
+
+void DownstreamKeyerDock::WatchChannelTransition()
+{
+	obs_source_t *prev = obs_weak_source_get_source(channelTransition);
+	if (prev) {
+		signal_handler_disconnect(obs_source_get_signal_handler(prev), "transition_start", channel_transition_start, this);
+		obs_source_release(prev);
+	}
+	obs_weak_source_release(channelTransition);
+	channelTransition = nullptr;
+
+	obs_canvas_t *c = obs_weak_canvas_get_canvas(canvas);
+	obs_source_t *source = c && !obs_canvas_removed(c) ? obs_canvas_get_channel(c, 0) : nullptr;
+	obs_canvas_release(c);
+	if (source && obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION) {
+		signal_handler_connect(obs_source_get_signal_handler(source), "transition_start", channel_transition_start, this);
+		channelTransition = obs_source_get_weak_source(source);
+	}
+	obs_source_release(source);
+}
+
+void DownstreamKeyerDock::ChannelChanged()
+{
+	if (closing)
+		return;
+	WatchChannelTransition();
+	SceneChanged();
+}
+
 void DownstreamKeyerDock::SetTransitions(get_transitions_callback_t gt, void *gtd)
 {
 	get_transitions = gt;
 	get_transitions_data = gtd;
+	const int count = tabs->count();
+	for (int i = 0; i < count; i++) {
+		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
+		if (w)
+			w->SetTransitions(gt, gtd);
+	}
 }
 
 void DownstreamKeyerDock::Save(obs_data_t *data)
@@ -405,9 +609,7 @@ void DownstreamKeyerDock::Save(obs_data_t *data)
 	int count = tabs->count();
 	for (int i = 0; i < count; i++) {
 		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
-		const auto keyerData = obs_data_create();
-		obs_data_set_string(keyerData, "name", QT_TO_UTF8(tabs->tabText(i)));
-		w->Save(keyerData);
+		const auto keyerData = w->GetSaveData(QT_TO_UTF8(tabs->tabText(i)));
 		obs_data_array_push_back(keyers, keyerData);
 		obs_data_release(keyerData);
 	}
@@ -418,10 +620,16 @@ void DownstreamKeyerDock::Save(obs_data_t *data)
 		s = viewName;
 		s += "_downstream_keyers";
 		obs_data_set_array(data, s.c_str(), keyers);
+		s = viewName;
+		s += "_downstream_keyers_composite";
+		obs_data_set_bool(data, s.c_str(), composite);
 
 	} else {
 		obs_data_set_int(data, "downstream_keyers_channel", outputChannel);
 		obs_data_set_array(data, "downstream_keyers", keyers);
+		obs_data_set_bool(data, "downstream_keyers_composite", composite);
+		obs_data_set_bool(data, "downstream_keyers_local_control", LocalControlRunning());
+		obs_data_set_bool(data, "downstream_keyers_shared_scene_hotkeys", DownstreamKeyer::GetSharedSceneHotkeys());
 	}
 	obs_data_array_release(keyers);
 }
@@ -447,6 +655,13 @@ void DownstreamKeyerDock::Load(obs_data_t *data)
 		keyers = obs_data_get_array(data, "downstream_keyers");
 	}
 	ClearKeyers();
+	if (viewName.empty()) {
+		SetSharedSceneHotkeys(obs_data_get_bool(data, "downstream_keyers_shared_scene_hotkeys"));
+		if (obs_data_get_bool(data, "downstream_keyers_local_control"))
+			StartLocalControl();
+		else
+			StopLocalControl();
+	}
 	if (keyers) {
 		auto count = obs_data_array_count(keyers);
 		if (count == 0) {
@@ -455,10 +670,21 @@ void DownstreamKeyerDock::Load(obs_data_t *data)
 		obs_canvas_t *c = obs_weak_canvas_get_canvas(canvas);
 		for (size_t i = 0; i < count; i++) {
 			auto keyerData = obs_data_array_item(keyers, i);
-			auto keyer = new DownstreamKeyer((int)(outputChannel + i), QT_UTF8(obs_data_get_string(keyerData, "name")),
+			const int channel = AllocateChannel(obs_data_has_user_value(keyerData, "channel")
+								    ? (int)obs_data_get_int(keyerData, "channel")
+								    : -1);
+			if (channel < 0) {
+				blog(LOG_WARNING, "[Downstream Keyer] no free output channel for '%s'",
+				     obs_data_get_string(keyerData, "name"));
+				obs_data_release(keyerData);
+				continue;
+			}
+			auto keyer = new DownstreamKeyer(channel, QT_UTF8(obs_data_get_string(keyerData, "name")),
 							 view, c, get_transitions, get_transitions_data);
+			keyer->SetViewName(viewName.c_str());
 			keyer->Load(keyerData);
 			tabs->addTab(keyer, keyer->objectName());
+			RegisterKeyer(keyer);
 			obs_data_release(keyerData);
 		}
 		obs_canvas_release(c);
@@ -466,6 +692,222 @@ void DownstreamKeyerDock::Load(obs_data_t *data)
 	} else {
 		AddDefaultKeyer();
 	}
+	if (!viewName.empty()) {
+		std::string s = viewName;
+		s += "_downstream_keyers_composite";
+		SetComposite(obs_data_get_bool(data, s.c_str()));
+	} else {
+		SetComposite(obs_data_get_bool(data, "downstream_keyers_composite"));
+	}
+	RequestStatePublish();
+}
+
+int DownstreamKeyerDock::AllocateChannel(int preferred)
+{
+	// channels stay with their keyer, tab order does not affect the render graph
+	std::set<int> used;
+	const int count = tabs->count();
+	for (int i = 0; i < count; i++) {
+		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
+		if (w)
+			used.insert(w->GetOutputChannel());
+	}
+	const int first = view || canvas ? 1 : 7;
+	if (preferred >= first && preferred < MAX_CHANNELS && used.count(preferred) == 0)
+		return preferred;
+	int start = outputChannel;
+	if (start < first || start >= MAX_CHANNELS)
+		start = first;
+	obs_canvas_t *c = obs_weak_canvas_get_canvas(canvas);
+	for (int channel = start; channel < MAX_CHANNELS; channel++) {
+		if (used.count(channel))
+			continue;
+		obs_source_t *source = view ? obs_view_get_source(view, channel)
+				       : c  ? obs_canvas_get_channel(c, channel)
+					    : obs_get_output_source(channel);
+		if (!source) {
+			obs_canvas_release(c);
+			return channel;
+		}
+		obs_source_release(source);
+	}
+	obs_canvas_release(c);
+	// no empty channel left, channels holding a source of another plugin are not taken over
+	return -1;
+}
+
+void DownstreamKeyerDock::MoveRenderOrder(int direction)
+{
+	auto w = dynamic_cast<DownstreamKeyer *>(tabs->currentWidget());
+	if (!w)
+		return;
+	if (composite) {
+		// composite slots are stacked in tab order
+		const int index = tabs->currentIndex();
+		if (index + direction >= 0 && index + direction < tabs->count())
+			tabs->tabBar()->moveTab(index, index + direction);
+		return;
+	}
+	const int channel = w->GetOutputChannel();
+	DownstreamKeyer *other = nullptr;
+	const int count = tabs->count();
+	for (int i = 0; i < count; i++) {
+		auto k = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
+		if (!k || k == w)
+			continue;
+		const int c = k->GetOutputChannel();
+		if (direction > 0 ? c <= channel : c >= channel)
+			continue;
+		if (!other || (direction > 0 ? c < other->GetOutputChannel() : c > other->GetOutputChannel()))
+			other = k;
+	}
+	if (!other)
+		return;
+	w->SwapOutputChannel(other);
+}
+
+// 1 is the bottom layer, in composite mode the tab order stacks the keyers, otherwise higher channels render on top
+int DownstreamKeyerDock::GetRenderLayer(DownstreamKeyer *keyer)
+{
+	if (composite)
+		return tabs->indexOf(keyer) + 1;
+	int layer = 1;
+	const int count = tabs->count();
+	for (int i = 0; i < count; i++) {
+		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
+		if (w && w != keyer && w->GetOutputChannel() < keyer->GetOutputChannel())
+			layer++;
+	}
+	return layer;
+}
+
+int DownstreamKeyerDock::GetRenderedChannels()
+{
+	if (compositeScene)
+		return 1;
+	int rendered = 0;
+	const int count = tabs->count();
+	for (int i = 0; i < count; i++) {
+		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
+		if (w && w->IsRendering())
+			rendered++;
+	}
+	return rendered;
+}
+
+void DownstreamKeyerDock::SetDockChannelSource(int channel, obs_source_t *source)
+{
+	if (view) {
+		obs_view_set_source(view, channel, source);
+	} else if (canvas) {
+		obs_canvas_t *c = obs_weak_canvas_get_canvas(canvas);
+		if (c)
+			obs_canvas_set_channel(c, channel, source);
+		obs_canvas_release(c);
+	} else {
+		obs_set_output_source(channel, source);
+	}
+}
+
+void DownstreamKeyerDock::SetComposite(bool enable)
+{
+	// the private scene renders at the main video size, views and canvases keep a channel per keyer
+	if (view || canvas)
+		enable = false;
+	if (enable == composite)
+		return;
+	composite = enable;
+	const int count = tabs->count();
+	for (int i = 0; i < count; i++) {
+		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
+		if (!w)
+			continue;
+		if (composite)
+			AddCompositeSlot(w);
+		else
+			w->SetCompositeSlot(nullptr);
+	}
+	if (!composite)
+		ReleaseCompositeScene();
+}
+
+void DownstreamKeyerDock::AddCompositeSlot(DownstreamKeyer *keyer)
+{
+	if (!composite || !keyer)
+		return;
+	if (!compositeScene) {
+		compositeChannel = AllocateChannel();
+		if (compositeChannel < 0) {
+			blog(LOG_WARNING, "[Downstream Keyer] no free output channel for the composite scene of '%s'",
+			     viewName.c_str());
+			composite = false;
+			return;
+		}
+		compositeScene = obs_scene_create_private("Downstream Keyer Composite");
+		SetDockChannelSource(compositeChannel, obs_scene_get_source(compositeScene));
+	}
+	obs_source_t *slot = obs_source_create_private("cut_transition", QT_TO_UTF8(keyer->objectName()), nullptr);
+	obs_sceneitem_t *item = obs_scene_add(compositeScene, slot);
+	obs_sceneitem_set_locked(item, true);
+	keyer->SetCompositeSlot(slot);
+	obs_source_release(slot);
+	RestackComposite();
+}
+
+void DownstreamKeyerDock::RemoveCompositeSlot(DownstreamKeyer *keyer)
+{
+	if (!compositeScene || !keyer || !keyer->GetCompositeSlot())
+		return;
+	obs_sceneitem_t *item = obs_scene_sceneitem_from_source(compositeScene, keyer->GetCompositeSlot());
+	if (item) {
+		obs_sceneitem_remove(item);
+		obs_sceneitem_release(item);
+	}
+}
+
+void DownstreamKeyerDock::RestackComposite()
+{
+	if (!compositeScene)
+		return;
+	const int count = tabs->count();
+	for (int i = 0; i < count; i++) {
+		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
+		if (!w || !w->GetCompositeSlot())
+			continue;
+		obs_sceneitem_t *item = obs_scene_sceneitem_from_source(compositeScene, w->GetCompositeSlot());
+		if (!item)
+			continue;
+		obs_sceneitem_set_order_position(item, i);
+		obs_sceneitem_release(item);
+	}
+}
+
+void DownstreamKeyerDock::ReleaseCompositeScene()
+{
+	if (!compositeScene)
+		return;
+	if (compositeChannel >= 0)
+		SetDockChannelSource(compositeChannel, nullptr);
+	compositeChannel = -1;
+	obs_scene_release(compositeScene);
+	compositeScene = nullptr;
+}
+
+void DownstreamKeyerDock::SetSharedSceneHotkeys(bool shared)
+{
+	std::vector<DownstreamKeyer *> keyers;
+	for (const auto &it : _dsks) {
+		// docks of removed canvases are already cleared and waiting for deletion
+		if (it.dock->closing)
+			continue;
+		const int count = it.dock->tabs->count();
+		for (int i = 0; i < count; i++) {
+			auto w = dynamic_cast<DownstreamKeyer *>(it.dock->tabs->widget(i));
+			if (w)
+				keyers.push_back(w);
+		}
+	}
+	DownstreamKeyer::SetSharedSceneHotkeys(shared, keyers);
 }
 
 void DownstreamKeyerDock::ClearKeyers()
@@ -475,7 +917,12 @@ void DownstreamKeyerDock::ClearKeyers()
 		tabs->removeTab(0);
 		delete w;
 	}
+	keyersByName.clear();
+	keyersById.clear();
+	ReleaseCompositeScene();
+	composite = false;
 	loaded = false;
+	RequestStatePublish();
 }
 
 void DownstreamKeyerDock::AddDefaultKeyer()
@@ -490,62 +937,45 @@ void DownstreamKeyerDock::AddDefaultKeyer()
 		if (outputChannel < 7 || outputChannel >= MAX_CHANNELS)
 			outputChannel = 7;
 	}
+	const int channel = AllocateChannel();
+	if (channel < 0) {
+		blog(LOG_WARNING, "[Downstream Keyer] no free output channel for the default keyer of '%s'", viewName.c_str());
+		return;
+	}
 	obs_canvas_t *c = obs_weak_canvas_get_canvas(canvas);
-	auto keyer = new DownstreamKeyer(outputChannel, QT_UTF8(obs_module_text("DefaultName")), view, c, get_transitions,
+	auto keyer = new DownstreamKeyer(channel, QT_UTF8(obs_module_text("DefaultName")), view, c, get_transitions,
 					 get_transitions_data);
+	keyer->SetViewName(viewName.c_str());
 	obs_canvas_release(c);
 	tabs->addTab(keyer, keyer->objectName());
+	RegisterKeyer(keyer);
+	AddCompositeSlot(keyer);
+	RequestStatePublish();
+}
+void DownstreamKeyerDock::QueueSceneChanged()
+{
+	// collapse scene changes arriving before the queued SceneChanged runs into a single pass
+	if (sceneChangePending.exchange(true)) {
+		coalescedSceneChanges++;
+		return;
+	}
+	QMetaObject::invokeMethod(this, "SceneChanged", Qt::QueuedConnection);
 }
+
 void DownstreamKeyerDock::SceneChanged()
 {
+	sceneChangePending = false;
 	if (closing)
 		return;
 	const int count = tabs->count();
 
-	obs_source_t *scene = nullptr;
-	if (view) {
-		obs_source_t *source = obs_view_get_source(view, 0);
-		while (source && obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION) {
-			obs_source_t *ts = obs_transition_get_active_source(source);
-			if (ts) {
-				obs_source_release(source);
-				source = ts;
-			} else {
-				break;
-			}
-		}
-		if (source && obs_source_is_scene(source)) {
-			scene = source;
-		} else {
-			obs_source_release(source);
-		}
-	} else if (canvas) {
-		obs_canvas_t *c = obs_weak_canvas_get_canvas(canvas);
-		obs_source_t *source = c && !obs_canvas_removed(c) ? obs_canvas_get_channel(c, 0) : nullptr;
-		obs_canvas_release(c);
-		while (source && obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION) {
-			obs_source_t *ts = obs_transition_get_active_source(source);
-			if (ts) {
-				obs_source_release(source);
-				source = ts;
-			} else {
-				break;
-			}
-		}
-		if (source && obs_source_is_scene(source)) {
-			scene = source;
-		} else {
-			obs_source_release(source);
-		}
-
-	} else {
-		scene = obs_frontend_get_current_scene();
-	}
-	std::string scene_name = scene ? obs_source_get_name(scene) : "";
+	obs_canvas_t *c = obs_weak_canvas_get_canvas(canvas);
+	obs_source_t *scene = canvas && !c ? nullptr : GetActiveScene(view, c);
+	obs_canvas_release(c);
 	for (int i = 0; i < count; i++) {
 		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
 		if (w)
-			w->SceneChanged(scene_name);
+			w->SceneChanged(scene);
 	}
 	obs_source_release(scene);
 }
@@ -630,13 +1060,44 @@ void DownstreamKeyerDock::AddExcludeSceneMenu(QMenu *tm)
 		a->setCheckable(true);
 		bool excluded = false;
 		if (w) {
-			excluded = w->IsSceneExcluded(name);
+			excluded = w->IsSceneExcluded(source, false);
 		}
 		a->setChecked(excluded);
 		excluded = !excluded;
 		connect(a, &QAction::triggered, [setSceneExclude, name, excluded] { return setSceneExclude(name, excluded); });
 	}
 	obs_frontend_source_list_free(&scenes);
+
+	tm->addSeparator();
+	if (w) {
+		for (const auto &r : w->GetExcludeRules()) {
+			auto a = tm->addAction(QT_UTF8((r.first + ": " + r.second).c_str()));
+			a->setCheckable(true);
+			a->setChecked(true);
+			connect(a, &QAction::triggered, [this, r] {
+				const auto w = dynamic_cast<DownstreamKeyer *>(tabs->currentWidget());
+				if (w)
+					w->RemoveExcludeRule(r.first.c_str(), r.second.c_str());
+			});
+		}
+	}
+	auto a = tm->addAction(QT_UTF8(obs_module_text("AddExcludeRule")));
+	connect(a, &QAction::triggered, [this] {
+		const QStringList types = {"glob", "regex", "prefix"};
+		bool ok = false;
+		const auto type = QInputDialog::getItem(this, QT_UTF8(obs_module_text("AddExcludeRule")),
+							QT_UTF8(obs_module_text("ExcludeRuleType")), types, 0, false, &ok);
+		if (!ok)
+			return;
+		const auto pattern = QInputDialog::getText(this, QT_UTF8(obs_module_text("AddExcludeRule")),
+							   QT_UTF8(obs_module_text("ExcludeRulePattern")), QLineEdit::Normal, "",
+							   &ok);
+		if (!ok || pattern.isEmpty())
+			return;
+		const auto w = dynamic_cast<DownstreamKeyer *>(tabs->currentWidget());
+		if (w)
+			w->AddExcludeRule(QT_TO_UTF8(type), QT_TO_UTF8(pattern));
+	});
 }
 
 void DownstreamKeyerDock::ConfigClicked()
@@ -675,23 +1136,76 @@ void DownstreamKeyerDock::ConfigClicked()
 	durationAction->setDefaultWidget(duration);
 
 	tm->addAction(durationAction);
+
+	a = popup.addAction(QT_UTF8(obs_module_text("PreloadTransitions")));
+	a->setCheckable(true);
+	a->setChecked(w->GetPreloadTransitions());
+	connect(a, &QAction::triggered, [this](bool checked) {
+		auto w = dynamic_cast<DownstreamKeyer *>(tabs->currentWidget());
+		if (w)
+			w->SetPreloadTransitions(checked);
+	});
+
+	popup.addSeparator();
+	a = popup.addAction(QT_UTF8(obs_module_text("RenderLayer")).arg(GetRenderLayer(w)).arg(tabs->count()));
+	a->setEnabled(false);
+	a = popup.addAction(QT_UTF8(obs_module_text("BringForward")));
+	connect(a, &QAction::triggered, [this] { MoveRenderOrder(1); });
+	a = popup.addAction(QT_UTF8(obs_module_text("SendBackward")));
+	connect(a, &QAction::triggered, [this] { MoveRenderOrder(-1); });
+
+	if (!view && !canvas) {
+		a = popup.addAction(QT_UTF8(obs_module_text("Composite")));
+		a->setCheckable(true);
+		a->setChecked(composite);
+		connect(a, &QAction::triggered, [this](bool checked) { SetComposite(checked); });
+	}
+
+	popup.addSeparator();
+	a = popup.addAction(QT_UTF8(obs_module_text("SharedSceneHotkeys")));
+	a->setCheckable(true);
+	a->setChecked(DownstreamKeyer::GetSharedSceneHotkeys());
+	connect(a, &QAction::triggered, [](bool checked) { SetSharedSceneHotkeys(checked); });
+#ifndef _WIN32
+	if (viewName.empty()) {
+		a = popup.addAction(QT_UTF8(obs_module_text("LocalControl")));
+		a->setCheckable(true);
+		a->setChecked(LocalControlRunning());
+		connect(a, &QAction::triggered, [](bool checked) {
+			if (checked)
+				StartLocalControl();
+			else
+				StopLocalControl();
+		});
+	}
+#endif
 	popup.exec(QCursor::pos());
 }
 
-void DownstreamKeyerDock::Add(QString name)
+bool DownstreamKeyerDock::Add(QString name)
 {
 	if (name.isEmpty()) {
 		std::string std_name = obs_module_text("DefaultName");
 		if (!NameDialog::AskForName(this, std_name))
-			return;
+			return false;
 		name = QString::fromUtf8(std_name.c_str());
 	}
 	if (outputChannel < 7 || outputChannel >= MAX_CHANNELS)
 		outputChannel = 7;
+	const int channel = AllocateChannel();
+	if (channel < 0) {
+		blog(LOG_WARNING, "[Downstream Keyer] no free output channel for '%s'", QT_TO_UTF8(name));
+		return false;
+	}
 	obs_canvas_t *c = obs_weak_canvas_get_canvas(canvas);
-	auto keyer = new DownstreamKeyer(outputChannel + tabs->count(), name, view, c, get_transitions, get_transitions_data);
+	auto keyer = new DownstreamKeyer(channel, name, view, c, get_transitions, get_transitions_data);
+	keyer->SetViewName(viewName.c_str());
 	obs_canvas_release(c);
 	tabs->addTab(keyer, keyer->objectName());
+	RegisterKeyer(keyer);
+	AddCompositeSlot(keyer);
+	RequestStatePublish();
+	return true;
 }
 
 void DownstreamKeyerDock::Rename()
@@ -701,7 +1215,13 @@ void DownstreamKeyerDock::Rename()
 		return;
 	std::string name = QT_TO_UTF8(tabs->tabText(i));
 	if (NameDialog::AskForName(this, name)) {
+		// the object name is what vendor requests and hotkeys address the keyer by, keep it in step with the tab
+		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
+		UnregisterKeyer(w);
+		w->SetName(QT_UTF8(name.c_str()));
+		RegisterKeyer(w);
 		tabs->setTabText(i, QT_UTF8(name.c_str()));
+		RequestStatePublish();
 	}
 }
 
@@ -711,154 +1231,352 @@ void DownstreamKeyerDock::Remove(int index)
 		index = tabs->currentIndex();
 	if (index < 0)
 		return;
-	auto w = tabs->widget(index);
+	auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(index));
+	RemoveCompositeSlot(w);
+	UnregisterKeyer(w);
 	tabs->removeTab(index);
 	delete w;
 	if (tabs->count() == 0) {
 		AddDefaultKeyer();
 	}
+	RequestStatePublish();
 }
-QString DownstreamKeyerDock::GetScene(QString dskName)
+void DownstreamKeyerDock::RegisterKeyer(DownstreamKeyer *keyer)
 {
-	const int count = tabs->count();
-	for (int i = 0; i < count; i++) {
-		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
-		if (w->objectName() == dskName) {
-			return w->GetScene();
-		}
-	}
-	return "";
+	keyersById.insert(keyer->GetId(), keyer);
+	// with duplicate names the first keyer keeps the name, as the tab scan did before
+	if (!keyersByName.contains(keyer->objectName()))
+		keyersByName.insert(keyer->objectName(), keyer);
 }
 
-bool DownstreamKeyerDock::SwitchDSK(QString dskName, QString sceneName)
+void DownstreamKeyerDock::UnregisterKeyer(DownstreamKeyer *keyer)
 {
+	keyersById.remove(keyer->GetId());
+	const QString name = keyer->objectName();
+	if (keyersByName.value(name) != keyer)
+		return;
+	keyersByName.remove(name);
 	const int count = tabs->count();
 	for (int i = 0; i < count; i++) {
 		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
-		if (w->objectName() == dskName) {
-			if (w->SwitchToScene(sceneName)) {
-				return true;
-			}
+		if (w && w != keyer && w->objectName() == name) {
+			keyersByName.insert(name, w);
+			break;
 		}
 	}
-	return false;
 }
 
-bool DownstreamKeyerDock::AddScene(QString dskName, QString sceneName, int insertBeforeRow)
+DownstreamKeyer *DownstreamKeyerDock::FindKeyer(const QString &dskName) const
 {
-	const int count = tabs->count();
-	for (int i = 0; i < count; i++) {
-		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
-		if (w->objectName() == dskName) {
-			if (w->AddScene(sceneName, insertBeforeRow)) {
-				return true;
-			}
-		}
-	}
-	return false;
+	return keyersByName.value(dskName, nullptr);
 }
 
-bool DownstreamKeyerDock::RemoveScene(QString dskName, QString sceneName)
+DownstreamKeyer *DownstreamKeyerDock::FindKeyer(uint32_t dskId) const
 {
-	const int count = tabs->count();
-	for (int i = 0; i < count; i++) {
-		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
-		if (w->objectName() == dskName) {
-			if (w->RemoveScene(sceneName)) {
-				return true;
-			}
-		}
-	}
-	return false;
+	return keyersById.value(dskId, nullptr);
+}
+
+QString DownstreamKeyerDock::GetScene(QString dskName)
+{
+	auto w = FindKeyer(dskName);
+	return w ? w->GetScene() : "";
+}
+
+bool DownstreamKeyerDock::SwitchDSK(QString dskName, QString sceneName)
+{
+	auto w = FindKeyer(dskName);
+	return w && w->SwitchToScene(sceneName);
+}
+
+bool DownstreamKeyerDock::CueDSK(QString dskName, QString sceneName)
+{
+	auto w = FindKeyer(dskName);
+	return w && w->CueScene(sceneName);
+}
+
+bool DownstreamKeyerDock::TakeDSK(QString dskName)
+{
+	auto w = FindKeyer(dskName);
+	return w && w->Take();
+}
+
+obs_data_t *DownstreamKeyerDock::GetState(QString dskName)
+{
+	auto w = FindKeyer(dskName);
+	return w ? w->GetState() : nullptr;
+}
+
+bool DownstreamKeyerDock::AddScene(QString dskName, QString sceneName, int insertBeforeRow)
+{
+	auto w = FindKeyer(dskName);
+	return w && w->AddScene(sceneName, insertBeforeRow);
+}
+
+bool DownstreamKeyerDock::RemoveScene(QString dskName, QString sceneName)
+{
+	auto w = FindKeyer(dskName);
+	return w && w->RemoveScene(sceneName);
+}
+
+bool DownstreamKeyerDock::SetScenes(QString dskName, const QStringList &sceneNames, QStringList &unresolved)
+{
+	auto w = FindKeyer(dskName);
+	if (!w)
+		return false;
+	w->SetScenes(sceneNames, unresolved);
+	return true;
 }
 
 bool DownstreamKeyerDock::SetTie(QString dskName, bool tie)
 {
-	const int count = tabs->count();
-	for (int i = 0; i < count; i++) {
-		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
-		if (w->objectName() == dskName) {
-			w->SetTie(tie);
-			return true;
-		}
-	}
-	return false;
+	auto w = FindKeyer(dskName);
+	if (!w)
+		return false;
+	w->SetTie(tie);
+	return true;
 }
 
 bool DownstreamKeyerDock::SetTransition(const QString &dskName, const char *transition, int duration, transitionType tt)
 {
-	const int count = tabs->count();
-	for (int i = 0; i < count; i++) {
-		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
-		if (w->objectName() == dskName) {
-			w->SetTransition(transition, tt);
-			w->SetTransitionDuration(duration, tt);
-			return true;
-		}
-	}
-	return false;
+	auto w = FindKeyer(dskName);
+	if (!w)
+		return false;
+	w->SetTransition(transition, tt);
+	w->SetTransitionDuration(duration, tt);
+	return true;
 }
 
 bool DownstreamKeyerDock::AddExcludeScene(QString dskName, const char *sceneName)
 {
-	const int count = tabs->count();
-	for (int i = 0; i < count; i++) {
-		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
-		if (w->objectName() == dskName) {
-			w->AddExcludeScene(sceneName);
-			return true;
+	auto w = FindKeyer(dskName);
+	if (!w)
+		return false;
+	w->AddExcludeScene(sceneName);
+	return true;
+}
+
+bool DownstreamKeyerDock::RemoveExcludeScene(QString dskName, const char *sceneName)
+{
+	auto w = FindKeyer(dskName);
+	if (!w)
+		return false;
+	w->RemoveExcludeScene(sceneName);
+	return true;
+}
+
+bool DownstreamKeyerDock::AddExcludeRule(QString dskName, const char *type, const char *pattern)
+{
+	auto w = FindKeyer(dskName);
+	return w && w->AddExcludeRule(type, pattern);
+}
+
+bool DownstreamKeyerDock::RemoveExcludeRule(QString dskName, const char *type, const char *pattern)
+{
+	auto w = FindKeyer(dskName);
+	return w && w->RemoveExcludeRule(type, pattern);
+}
+
+
+void RequestStatePublish()
+{
+	state_snapshot_dirty = true;
+	if (state_publish_pending.exchange(true))
+		return;
+	QMetaObject::invokeMethod(
+		qApp,
+		[]() {
+			state_publish_pending = false;
+			DownstreamKeyerDock::PublishState();
+		},
+		Qt::QueuedConnection);
+}
+
+void DownstreamKeyerDock::RefreshStateSnapshot()
+{
+	ReleaseStateSnapshot();
+	for (const auto &it : _dsks) {
+		if (it.dock->closing)
+			continue;
+		const int count = it.dock->tabs->count();
+		for (int i = 0; i < count; i++) {
+			auto w = dynamic_cast<DownstreamKeyer *>(it.dock->tabs->widget(i));
+			if (!w)
+				continue;
+			obs_data_t *state = w->GetState();
+			obs_data_set_string(state, "view_name", it.name.c_str());
+			state_snapshot.push_back(state);
 		}
 	}
-	return false;
 }
 
-bool DownstreamKeyerDock::RemoveExcludeScene(QString dskName, const char *sceneName)
+void DownstreamKeyerDock::PublishState()
 {
-	const int count = tabs->count();
-	for (int i = 0; i < count; i++) {
-		auto w = dynamic_cast<DownstreamKeyer *>(tabs->widget(i));
-		if (w->objectName() == dskName) {
-			w->RemoveExcludeScene(sceneName);
-			return true;
+	std::vector<dsk_state_keyer> keyers;
+	for (const auto &it : _dsks) {
+		if (it.dock->closing)
+			continue;
+		const int count = it.dock->tabs->count();
+		for (int i = 0; i < count; i++) {
+			auto w = dynamic_cast<DownstreamKeyer *>(it.dock->tabs->widget(i));
+			if (!w)
+				continue;
+			obs_data_t *state = w->GetState();
+			dsk_state_keyer keyer = {};
+			snprintf(keyer.view_name, sizeof(keyer.view_name), "%s", it.name.c_str());
+			snprintf(keyer.dsk_name, sizeof(keyer.dsk_name), "%s", obs_data_get_string(state, "dsk_name"));
+			snprintf(keyer.scene, sizeof(keyer.scene), "%s", obs_data_get_string(state, "scene"));
+			snprintf(keyer.cued_scene, sizeof(keyer.cued_scene), "%s", obs_data_get_string(state, "cued_scene"));
+			keyer.channel = (int32_t)obs_data_get_int(state, "dsk_channel");
+			keyer.tie = obs_data_get_bool(state, "tie");
+			keyer.rendering = obs_data_get_bool(state, "rendering");
+			keyer.phase = strcmp(obs_data_get_string(state, "transition_phase"), "transitioning") == 0
+					      ? DSK_STATE_TRANSITIONING
+					      : DSK_STATE_IDLE;
+			keyer.transitions_ready = obs_data_get_bool(state, "transitions_ready");
+			keyer.transition_duration_ms = (uint32_t)obs_data_get_int(state, "running_transition_duration");
+			keyer.transition_start_ns = (uint64_t)obs_data_get_int(state, "transition_start_ns");
+			obs_data_release(state);
+			keyers.push_back(keyer);
 		}
 	}
-	return false;
+	WriteStateExport(keyers);
+}
+
+static DownstreamKeyerDock *proc_find_dock(calldata_t *cd)
+{
+	const char *viewName = calldata_string(cd, "view_name");
+	return _dsks.Find(viewName);
+}
+
+void DownstreamKeyerDock::proc_select_scene(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	bool success = false;
+	run_on_ui_thread([cd, &success]() {
+		auto dsk = proc_find_dock(cd);
+		const char *dsk_name = calldata_string(cd, "dsk_name");
+		if (dsk && dsk_name)
+			success = dsk->SwitchDSK(QString::fromUtf8(dsk_name), QString::fromUtf8(calldata_string(cd, "scene")));
+	});
+	calldata_set_bool(cd, "success", success);
+}
+
+void DownstreamKeyerDock::proc_cue_scene(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	bool success = false;
+	run_on_ui_thread([cd, &success]() {
+		auto dsk = proc_find_dock(cd);
+		const char *dsk_name = calldata_string(cd, "dsk_name");
+		if (dsk && dsk_name)
+			success = dsk->CueDSK(QString::fromUtf8(dsk_name), QString::fromUtf8(calldata_string(cd, "scene")));
+	});
+	calldata_set_bool(cd, "success", success);
+}
+
+void DownstreamKeyerDock::proc_take(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	bool success = false;
+	run_on_ui_thread([cd, &success]() {
+		auto dsk = proc_find_dock(cd);
+		const char *dsk_name = calldata_string(cd, "dsk_name");
+		if (dsk && dsk_name)
+			success = dsk->TakeDSK(QString::fromUtf8(dsk_name));
+	});
+	calldata_set_bool(cd, "success", success);
+}
+
+void DownstreamKeyerDock::proc_set_tie(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	bool success = false;
+	run_on_ui_thread([cd, &success]() {
+		auto dsk = proc_find_dock(cd);
+		const char *dsk_name = calldata_string(cd, "dsk_name");
+		if (dsk && dsk_name)
+			success = dsk->SetTie(QString::fromUtf8(dsk_name), calldata_bool(cd, "tie"));
+	});
+	calldata_set_bool(cd, "success", success);
+}
+
+void DownstreamKeyerDock::proc_set_transition(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	bool success = false;
+	run_on_ui_thread([cd, &success]() {
+		auto dsk = proc_find_dock(cd);
+		const char *dsk_name = calldata_string(cd, "dsk_name");
+		const char *transition_type = calldata_string(cd, "transition_type");
+		transitionType tt = transitionType::match;
+		if (transition_type && strcmp(transition_type, "show") == 0)
+			tt = transitionType::show;
+		else if (transition_type && strcmp(transition_type, "hide") == 0)
+			tt = transitionType::hide;
+		if (dsk && dsk_name)
+			success = dsk->SetTransition(QString::fromUtf8(dsk_name), calldata_string(cd, "transition"),
+						     (int)calldata_int(cd, "duration"), tt);
+	});
+	calldata_set_bool(cd, "success", success);
+}
+
+void DownstreamKeyerDock::proc_get_state(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	obs_data_t *state = nullptr;
+	run_on_ui_thread([cd, &state]() {
+		auto dsk = proc_find_dock(cd);
+		const char *dsk_name = calldata_string(cd, "dsk_name");
+		if (dsk && dsk_name)
+			state = dsk->GetState(QString::fromUtf8(dsk_name));
+	});
+	calldata_set_bool(cd, "success", state != nullptr);
+	if (!state)
+		return;
+	calldata_set_string(cd, "scene", obs_data_get_string(state, "scene"));
+	calldata_set_string(cd, "cued_scene", obs_data_get_string(state, "cued_scene"));
+	calldata_set_int(cd, "channel", obs_data_get_int(state, "dsk_channel"));
+	calldata_set_bool(cd, "tie", obs_data_get_bool(state, "tie"));
+	calldata_set_bool(cd, "rendering", obs_data_get_bool(state, "rendering"));
+	calldata_set_string(cd, "transition_phase", obs_data_get_string(state, "transition_phase"));
+	calldata_set_float(cd, "transition_progress", obs_data_get_double(state, "transition_progress"));
+	calldata_set_bool(cd, "transitions_ready", obs_data_get_bool(state, "transitions_ready"));
+	obs_data_release(state);
 }
 
 void DownstreamKeyerDock::get_downstream_keyers(obs_data_t *request_data, obs_data_t *response_data, void *param)
 {
 	UNUSED_PARAMETER(param);
 	const char *viewName = obs_data_get_string(request_data, "view_name");
-	if (_dsks.find(viewName) == _dsks.end())
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk)
 		return;
-	_dsks[viewName]->Save(response_data);
+	dsk->Save(response_data);
+	obs_data_set_int(response_data, "coalesced_scene_changes", (long long)dsk->coalescedSceneChanges);
+	obs_data_set_int(response_data, "rendered_channels", dsk->GetRenderedChannels());
 }
 
 void DownstreamKeyerDock::get_downstream_keyer(obs_data_t *request_data, obs_data_t *response_data, void *param)
 {
 	UNUSED_PARAMETER(param);
 	const char *viewName = obs_data_get_string(request_data, "view_name");
-	if (_dsks.find(viewName) == _dsks.end()) {
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
 		obs_data_set_string(response_data, "error", "'view_name' not found");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	auto dsk = _dsks[viewName];
 	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
 	if (!dsk_name || !strlen(dsk_name)) {
 		obs_data_set_string(response_data, "error", "'dsk_name' not set");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	QString dskName = QString::fromUtf8(dsk_name);
-	const int count = dsk->tabs->count();
-	for (int i = 0; i < count; i++) {
-		auto w = dynamic_cast<DownstreamKeyer *>(dsk->tabs->widget(i));
-		if (w->objectName() == dskName) {
-			obs_data_set_bool(response_data, "success", true);
-			w->Save(response_data);
-			return;
-		}
+	auto w = dsk->FindKeyer(QString::fromUtf8(dsk_name));
+	if (w) {
+		obs_data_set_bool(response_data, "success", true);
+		w->Save(response_data);
+		return;
 	}
 	obs_data_set_bool(response_data, "success", false);
 	obs_data_set_string(response_data, "error", "No downstream keyer with that name found");
@@ -868,12 +1586,12 @@ void DownstreamKeyerDock::add_downstream_keyer(obs_data_t *request_data, obs_dat
 {
 	UNUSED_PARAMETER(param);
 	const char *viewName = obs_data_get_string(request_data, "view_name");
-	if (_dsks.find(viewName) == _dsks.end()) {
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
 		obs_data_set_string(response_data, "error", "'view_name' not found");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	auto dsk = _dsks[viewName];
 	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
 	if (!dsk_name || !strlen(dsk_name)) {
 		obs_data_set_string(response_data, "error", "'dsk_name' not set");
@@ -881,16 +1599,16 @@ void DownstreamKeyerDock::add_downstream_keyer(obs_data_t *request_data, obs_dat
 		return;
 	}
 	QString dskName = QString::fromUtf8(dsk_name);
-	const int count = dsk->tabs->count();
-	for (int i = 0; i < count; i++) {
-		auto w = dynamic_cast<DownstreamKeyer *>(dsk->tabs->widget(i));
-		if (w->objectName() == dskName) {
-			obs_data_set_string(response_data, "error", "'dsk_name' exists");
-			obs_data_set_bool(response_data, "success", false);
-			return;
-		}
+	if (dsk->FindKeyer(dskName)) {
+		obs_data_set_string(response_data, "error", "'dsk_name' exists");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	if (!dsk->Add(dskName)) {
+		obs_data_set_string(response_data, "error", "no free output channel");
+		obs_data_set_bool(response_data, "success", false);
+		return;
 	}
-	QMetaObject::invokeMethod(dsk, "Add", Q_ARG(QString, dskName));
 	obs_data_set_bool(response_data, "success", true);
 }
 
@@ -898,27 +1616,23 @@ void DownstreamKeyerDock::remove_downstream_keyer(obs_data_t *request_data, obs_
 {
 	UNUSED_PARAMETER(param);
 	const char *viewName = obs_data_get_string(request_data, "view_name");
-	if (_dsks.find(viewName) == _dsks.end()) {
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
 		obs_data_set_string(response_data, "error", "'view_name' not found");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	auto dsk = _dsks[viewName];
 	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
 	if (!dsk_name || !strlen(dsk_name)) {
 		obs_data_set_string(response_data, "error", "'dsk_name' not set");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	QString dskName = QString::fromUtf8(dsk_name);
-	const int count = dsk->tabs->count();
-	for (int i = 0; i < count; i++) {
-		auto w = dynamic_cast<DownstreamKeyer *>(dsk->tabs->widget(i));
-		if (w->objectName() == dskName) {
-			QMetaObject::invokeMethod(dsk, "Remove", Q_ARG(int, i));
-			obs_data_set_bool(response_data, "success", true);
-			return;
-		}
+	auto w = dsk->FindKeyer(QString::fromUtf8(dsk_name));
+	if (w) {
+		QMetaObject::invokeMethod(dsk, "Remove", Q_ARG(int, dsk->tabs->indexOf(w)));
+		obs_data_set_bool(response_data, "success", true);
+		return;
 	}
 	obs_data_set_string(response_data, "error", "No downstream keyer with that name found");
 }
@@ -927,12 +1641,12 @@ void DownstreamKeyerDock::get_scene(obs_data_t *request_data, obs_data_t *respon
 {
 	UNUSED_PARAMETER(param);
 	const char *viewName = obs_data_get_string(request_data, "view_name");
-	if (_dsks.find(viewName) == _dsks.end()) {
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
 		obs_data_set_string(response_data, "error", "'view_name' not found");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	auto dsk = _dsks[viewName];
 	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
 	if (!dsk_name || !strlen(dsk_name)) {
 		obs_data_set_string(response_data, "error", "'dsk_name' not set");
@@ -948,12 +1662,12 @@ void DownstreamKeyerDock::change_scene(obs_data_t *request_data, obs_data_t *res
 {
 	UNUSED_PARAMETER(param);
 	const char *viewName = obs_data_get_string(request_data, "view_name");
-	if (_dsks.find(viewName) == _dsks.end()) {
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
 		obs_data_set_string(response_data, "error", "'view_name' not found");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	auto dsk = _dsks[viewName];
 	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
 	const char *scene_name = obs_data_get_string(request_data, "scene");
 	if (!scene_name) {
@@ -969,16 +1683,193 @@ void DownstreamKeyerDock::change_scene(obs_data_t *request_data, obs_data_t *res
 	obs_data_set_bool(response_data, "success", dsk->SwitchDSK(QString::fromUtf8(dsk_name), QString::fromUtf8(scene_name)));
 }
 
+void DownstreamKeyerDock::cue_scene(obs_data_t *request_data, obs_data_t *response_data, void *param)
+{
+	UNUSED_PARAMETER(param);
+	const char *viewName = obs_data_get_string(request_data, "view_name");
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
+		obs_data_set_string(response_data, "error", "'view_name' not found");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
+	const char *scene_name = obs_data_get_string(request_data, "scene");
+	if (!dsk_name || !strlen(dsk_name)) {
+		obs_data_set_string(response_data, "error", "'dsk_name' not set");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	obs_data_set_bool(response_data, "success", dsk->CueDSK(QString::fromUtf8(dsk_name), QString::fromUtf8(scene_name)));
+}
+
+void DownstreamKeyerDock::take(obs_data_t *request_data, obs_data_t *response_data, void *param)
+{
+	UNUSED_PARAMETER(param);
+	const char *viewName = obs_data_get_string(request_data, "view_name");
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
+		obs_data_set_string(response_data, "error", "'view_name' not found");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
+	if (!dsk_name || !strlen(dsk_name)) {
+		obs_data_set_string(response_data, "error", "'dsk_name' not set");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	obs_data_set_bool(response_data, "success", dsk->TakeDSK(QString::fromUtf8(dsk_name)));
+}
+
+void DownstreamKeyerDock::get_state(obs_data_t *request_data, obs_data_t *response_data, void *param)
+{
+	UNUSED_PARAMETER(param);
+	const char *viewName = obs_data_get_string(request_data, "view_name");
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
+		obs_data_set_string(response_data, "error", "'view_name' not found");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	// dsk_id keeps addressing the same keyer after it is renamed
+	if (obs_data_has_user_value(request_data, "dsk_id")) {
+		auto w = dsk->FindKeyer((uint32_t)obs_data_get_int(request_data, "dsk_id"));
+		if (!w) {
+			obs_data_set_string(response_data, "error", "'dsk_id' not found");
+			obs_data_set_bool(response_data, "success", false);
+			return;
+		}
+		obs_data_t *state = w->GetState();
+		obs_data_apply(response_data, state);
+		obs_data_release(state);
+		obs_data_set_bool(response_data, "success", true);
+		return;
+	}
+	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
+	if (!dsk_name || !strlen(dsk_name)) {
+		obs_data_set_string(response_data, "error", "'dsk_name' not set");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	obs_data_t *state = dsk->GetState(QString::fromUtf8(dsk_name));
+	if (!state) {
+		obs_data_set_string(response_data, "error", "'dsk_name' not found");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	obs_data_apply(response_data, state);
+	obs_data_release(state);
+	obs_data_set_bool(response_data, "success", true);
+}
+
+// fields of the cached state that dsk_query can return, all of them only change on keyer events.
+// Progress of a running transition follows from transition_start_ns and running_transition_duration, or dsk_get_state.
+static const char *query_fields[] = {
+	"scene",
+	"cued_scene",
+	"dsk_channel",
+	"tie",
+	"rendering",
+	"transition",
+	"transition_duration",
+	"show_transition",
+	"show_transition_duration",
+	"hide_transition",
+	"hide_transition_duration",
+	"transition_phase",
+	"transition_start_ns",
+	"running_transition_duration",
+	"transitions_ready",
+	"preload_transitions",
+	"last_transition_duration",
+};
+
+static void copy_query_field(obs_data_t *dst, obs_data_t *src, const char *name)
+{
+	obs_data_item_t *item = obs_data_item_byname(src, name);
+	if (!item)
+		return;
+	switch (obs_data_item_gettype(item)) {
+	case OBS_DATA_STRING:
+		obs_data_set_string(dst, name, obs_data_item_get_string(item));
+		break;
+	case OBS_DATA_NUMBER:
+		if (obs_data_item_numtype(item) == OBS_DATA_NUM_INT)
+			obs_data_set_int(dst, name, obs_data_item_get_int(item));
+		else
+			obs_data_set_double(dst, name, obs_data_item_get_double(item));
+		break;
+	case OBS_DATA_BOOLEAN:
+		obs_data_set_bool(dst, name, obs_data_item_get_bool(item));
+		break;
+	default:
+		break;
+	}
+	obs_data_item_release(&item);
+}
+
+void DownstreamKeyerDock::query(obs_data_t *request_data, obs_data_t *response_data, void *param)
+{
+	UNUSED_PARAMETER(param);
+	std::vector<const char *> fields;
+	for (const auto &field : QString::fromUtf8(obs_data_get_string(request_data, "fields")).split(",", Qt::SkipEmptyParts)) {
+		const std::string name = field.trimmed().toStdString();
+		auto found = std::find_if(std::begin(query_fields), std::end(query_fields),
+					  [&name](const char *f) { return name == f; });
+		if (found == std::end(query_fields)) {
+			std::string error = "unknown field '" + name + "'";
+			obs_data_set_string(response_data, "error", error.c_str());
+			obs_data_set_bool(response_data, "success", false);
+			return;
+		}
+		fields.push_back(*found);
+	}
+	if (fields.empty())
+		fields.assign(std::begin(query_fields), std::end(query_fields));
+	QStringList dskNames = QString::fromUtf8(obs_data_get_string(request_data, "dsk_names")).split(",", Qt::SkipEmptyParts);
+	for (auto &dskName : dskNames)
+		dskName = dskName.trimmed();
+	// without view_name every view is included, an empty view_name is the main dock
+	const bool allViews = !obs_data_has_user_value(request_data, "view_name");
+	const char *viewName = obs_data_get_string(request_data, "view_name");
+
+	// rebuild once after a change, independent of the queued state export
+	if (state_snapshot_dirty.exchange(false))
+		RefreshStateSnapshot();
+
+	obs_data_array_t *keyers = obs_data_array_create();
+	for (auto state : state_snapshot) {
+		const char *view = obs_data_get_string(state, "view_name");
+		if (!allViews && strcmp(view, viewName) != 0)
+			continue;
+		const char *dskName = obs_data_get_string(state, "dsk_name");
+		if (!dskNames.isEmpty() && !dskNames.contains(QString::fromUtf8(dskName)))
+			continue;
+		obs_data_t *keyer = obs_data_create();
+		obs_data_set_string(keyer, "view_name", view);
+		obs_data_set_string(keyer, "dsk_name", dskName);
+		obs_data_set_int(keyer, "dsk_id", obs_data_get_int(state, "dsk_id"));
+		for (auto field : fields)
+			copy_query_field(keyer, state, field);
+		obs_data_array_push_back(keyers, keyer);
+		obs_data_release(keyer);
+	}
+	obs_data_set_array(response_data, "keyers", keyers);
+	obs_data_array_release(keyers);
+	obs_data_set_bool(response_data, "success", true);
+}
+
 void DownstreamKeyerDock::add_scene(obs_data_t *request_data, obs_data_t *response_data, void *param)
 {
 	UNUSED_PARAMETER(param);
 	const char *viewName = obs_data_get_string(request_data, "view_name");
-	if (_dsks.find(viewName) == _dsks.end()) {
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
 		obs_data_set_string(response_data, "error", "'view_name' not found");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	auto dsk = _dsks[viewName];
 	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
 	const char *scene_name = obs_data_get_string(request_data, "scene");
 	int insertBeforeRow = obs_data_get_int(request_data, "insertBeforeRow");
@@ -1002,12 +1893,12 @@ void DownstreamKeyerDock::remove_scene(obs_data_t *request_data, obs_data_t *res
 {
 	UNUSED_PARAMETER(param);
 	const char *viewName = obs_data_get_string(request_data, "view_name");
-	if (_dsks.find(viewName) == _dsks.end()) {
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
 		obs_data_set_string(response_data, "error", "'view_name' not found");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	auto dsk = _dsks[viewName];
 	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
 	const char *scene_name = obs_data_get_string(request_data, "scene");
 	if (!scene_name || !strlen(scene_name)) {
@@ -1023,16 +1914,65 @@ void DownstreamKeyerDock::remove_scene(obs_data_t *request_data, obs_data_t *res
 	obs_data_set_bool(response_data, "success", dsk->RemoveScene(QString::fromUtf8(dsk_name), QString::fromUtf8(scene_name)));
 }
 
+void DownstreamKeyerDock::set_scenes(obs_data_t *request_data, obs_data_t *response_data, void *param)
+{
+	UNUSED_PARAMETER(param);
+	const char *viewName = obs_data_get_string(request_data, "view_name");
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
+		obs_data_set_string(response_data, "error", "'view_name' not found");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
+	if (!dsk_name || !strlen(dsk_name)) {
+		obs_data_set_string(response_data, "error", "'dsk_name' not set");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	obs_data_array_t *scenes = obs_data_get_array(request_data, "scenes");
+	if (!scenes) {
+		obs_data_set_string(response_data, "error", "'scenes' not set");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	// same shape as the "scenes" array in get_downstream_keyer, a list of objects with a name
+	QStringList sceneNames;
+	const size_t count = obs_data_array_count(scenes);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *scene = obs_data_array_item(scenes, i);
+		sceneNames.append(QString::fromUtf8(obs_data_get_string(scene, "name")));
+		obs_data_release(scene);
+	}
+	obs_data_array_release(scenes);
+	QStringList unresolved;
+	if (!dsk->SetScenes(QString::fromUtf8(dsk_name), sceneNames, unresolved)) {
+		obs_data_set_string(response_data, "error", "'dsk_name' not found");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	obs_data_array_t *unresolvedArray = obs_data_array_create();
+	for (const auto &name : unresolved) {
+		obs_data_t *scene = obs_data_create();
+		obs_data_set_string(scene, "name", QT_TO_UTF8(name));
+		obs_data_array_push_back(unresolvedArray, scene);
+		obs_data_release(scene);
+	}
+	obs_data_set_array(response_data, "unresolved", unresolvedArray);
+	obs_data_array_release(unresolvedArray);
+	obs_data_set_bool(response_data, "success", true);
+}
+
 void DownstreamKeyerDock::set_tie(obs_data_t *request_data, obs_data_t *response_data, void *param)
 {
 	UNUSED_PARAMETER(param);
 	const char *viewName = obs_data_get_string(request_data, "view_name");
-	if (_dsks.find(viewName) == _dsks.end()) {
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
 		obs_data_set_string(response_data, "error", "'view_name' not found");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	auto dsk = _dsks[viewName];
 	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
 	if (!obs_data_has_user_value(request_data, "tie")) {
 		obs_data_set_string(response_data, "error", "'tie' not set");
@@ -1052,12 +1992,12 @@ void DownstreamKeyerDock::set_transition(obs_data_t *request_data, obs_data_t *r
 {
 	UNUSED_PARAMETER(param);
 	const char *viewName = obs_data_get_string(request_data, "view_name");
-	if (_dsks.find(viewName) == _dsks.end()) {
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
 		obs_data_set_string(response_data, "error", "'view_name' not found");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	auto dsk = _dsks[viewName];
 	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
 	const char *transition = obs_data_get_string(request_data, "transition");
 	const char *transition_type = obs_data_get_string(request_data, "transition_type");
@@ -1085,12 +2025,12 @@ void DownstreamKeyerDock::add_exclude_scene(obs_data_t *request_data, obs_data_t
 {
 	UNUSED_PARAMETER(param);
 	const char *viewName = obs_data_get_string(request_data, "view_name");
-	if (_dsks.find(viewName) == _dsks.end()) {
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
 		obs_data_set_string(response_data, "error", "'view_name' not found");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	auto dsk = _dsks[viewName];
 	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
 	const char *scene_name = obs_data_get_string(request_data, "scene");
 	if (!scene_name || !strlen(scene_name)) {
@@ -1110,12 +2050,12 @@ void DownstreamKeyerDock::remove_exclude_scene(obs_data_t *request_data, obs_dat
 {
 	UNUSED_PARAMETER(param);
 	const char *viewName = obs_data_get_string(request_data, "view_name");
-	if (_dsks.find(viewName) == _dsks.end()) {
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
 		obs_data_set_string(response_data, "error", "'view_name' not found");
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	auto dsk = _dsks[viewName];
 	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
 	const char *scene_name = obs_data_get_string(request_data, "scene");
 	if (!scene_name || !strlen(scene_name)) {
@@ -1130,3 +2070,97 @@ void DownstreamKeyerDock::remove_exclude_scene(obs_data_t *request_data, obs_dat
 	}
 	obs_data_set_bool(response_data, "success", dsk->RemoveExcludeScene(QString::fromUtf8(dsk_name), scene_name));
 }
+
+void DownstreamKeyerDock::add_exclude_rule(obs_data_t *request_data, obs_data_t *response_data, void *param)
+{
+	UNUSED_PARAMETER(param);
+	const char *viewName = obs_data_get_string(request_data, "view_name");
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
+		obs_data_set_string(response_data, "error", "'view_name' not found");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
+	const char *type = obs_data_get_string(request_data, "type");
+	const char *pattern = obs_data_get_string(request_data, "pattern");
+	if (!pattern || !strlen(pattern)) {
+		obs_data_set_string(response_data, "error", "'pattern' not set");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	if (!dsk_name || !strlen(dsk_name)) {
+		obs_data_set_string(response_data, "error", "'dsk_name' not set");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	obs_data_set_bool(response_data, "success", dsk->AddExcludeRule(QString::fromUtf8(dsk_name), type, pattern));
+}
+
+void DownstreamKeyerDock::remove_exclude_rule(obs_data_t *request_data, obs_data_t *response_data, void *param)
+{
+	UNUSED_PARAMETER(param);
+	const char *viewName = obs_data_get_string(request_data, "view_name");
+	auto dsk = _dsks.Find(viewName);
+	if (!dsk) {
+		obs_data_set_string(response_data, "error", "'view_name' not found");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	const char *dsk_name = obs_data_get_string(request_data, "dsk_name");
+	const char *type = obs_data_get_string(request_data, "type");
+	const char *pattern = obs_data_get_string(request_data, "pattern");
+	if (!pattern || !strlen(pattern)) {
+		obs_data_set_string(response_data, "error", "'pattern' not set");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	if (!dsk_name || !strlen(dsk_name)) {
+		obs_data_set_string(response_data, "error", "'dsk_name' not set");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	obs_data_set_bool(response_data, "success", dsk->RemoveExcludeRule(QString::fromUtf8(dsk_name), type, pattern));
+}
+
+void DownstreamKeyerDock::subscribe(obs_data_t *request_data, obs_data_t *response_data, void *param)
+{
+	UNUSED_PARAMETER(param);
+	// vendor events are broadcast, the subscriber id only lets clients recognise events meant for them.
+	// The subscription lasts 'ttl' seconds (default 60), clients repeat subscribe to keep it.
+	const char *subscriber = obs_data_get_string(request_data, "subscriber");
+	if (!subscriber || !strlen(subscriber)) {
+		obs_data_set_string(response_data, "error", "'subscriber' not set");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	std::vector<std::string> events;
+	for (const auto &event : QString::fromUtf8(obs_data_get_string(request_data, "events")).split(",", Qt::SkipEmptyParts))
+		events.push_back(event.trimmed().toStdString());
+	int ttl = obs_data_has_user_value(request_data, "ttl") ? (int)obs_data_get_int(request_data, "ttl") : 60;
+	ttl = std::clamp(ttl, 1, 3600);
+	SubscribeEvents(subscriber, obs_data_get_string(request_data, "view_name"), obs_data_get_string(request_data, "dsk_name"),
+			events, ttl);
+	obs_data_set_int(response_data, "ttl", ttl);
+	obs_data_set_bool(response_data, "success", true);
+}
+
+void DownstreamKeyerDock::unsubscribe(obs_data_t *request_data, obs_data_t *response_data, void *param)
+{
+	UNUSED_PARAMETER(param);
+	const char *subscriber = obs_data_get_string(request_data, "subscriber");
+	if (!subscriber || !strlen(subscriber)) {
+		obs_data_set_string(response_data, "error", "'subscriber' not set");
+		obs_data_set_bool(response_data, "success", false);
+		return;
+	}
+	obs_data_set_bool(response_data, "success", UnsubscribeEvents(subscriber));
+}
+
+void DownstreamKeyerDock::set_event_coalescing(obs_data_t *request_data, obs_data_t *response_data, void *param)
+{
+	UNUSED_PARAMETER(param);
+	SetEventCoalescing((int)obs_data_get_int(request_data, "window"));
+	obs_data_set_int(response_data, "window", GetEventCoalescing());
+	obs_data_set_bool(response_data, "success", true);
+}
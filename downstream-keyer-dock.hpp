@@ -4,6 +4,8 @@
 #include <QTabWidget>
 #include <QVBoxLayout>
 #include <QFrame>
+#include <QHash>
+#include <atomic>
 #include <obs-frontend-api.h>
 #include "downstream-keyer.hpp"
 #include "obs-websocket-api.h"
@@ -20,17 +22,50 @@ private:
 	std::string viewName;
 	get_transitions_callback_t get_transitions = nullptr;
 	void *get_transitions_data = nullptr;
+	obs_weak_source_t *channelTransition = nullptr;
+	std::atomic<bool> sceneChangePending = false;
+	std::atomic<uint64_t> coalescedSceneChanges = 0;
+	bool composite = false;
+	obs_scene_t *compositeScene = nullptr;
+	int compositeChannel = -1;
+	QHash<QString, DownstreamKeyer *> keyersByName;
+	QHash<uint32_t, DownstreamKeyer *> keyersById;
+
+	static void canvas_channel_change(void *data, calldata_t *cd);
+	static void channel_transition_start(void *data, calldata_t *cd);
+	void WatchChannelTransition();
+	void QueueSceneChanged();
+	int AllocateChannel(int preferred = -1);
+	void MoveRenderOrder(int direction);
+	int GetRenderLayer(DownstreamKeyer *keyer);
+	int GetRenderedChannels();
+	void SetDockChannelSource(int channel, obs_source_t *source);
+	void SetComposite(bool enable);
+	void AddCompositeSlot(DownstreamKeyer *keyer);
+	void RemoveCompositeSlot(DownstreamKeyer *keyer);
+	void RestackComposite();
+	void ReleaseCompositeScene();
+	void RegisterKeyer(DownstreamKeyer *keyer);
+	void UnregisterKeyer(DownstreamKeyer *keyer);
+	DownstreamKeyer *FindKeyer(const QString &dskName) const;
+	DownstreamKeyer *FindKeyer(uint32_t dskId) const;
 
 	void Save(obs_data_t *data);
 	void Load(obs_data_t *data);
 	QString GetScene(QString dskName);
 	bool SwitchDSK(QString dskName, QString sceneName);
+	bool CueDSK(QString dskName, QString sceneName);
+	bool TakeDSK(QString dskName);
+	obs_data_t *GetState(QString dskName);
 	bool AddScene(QString dskName, QString sceneName, int insertBeforeRow);
 	bool RemoveScene(QString dskName, QString sceneName);
+	bool SetScenes(QString dskName, const QStringList &sceneNames, QStringList &unresolved);
 	bool SetTie(QString dskName, bool tie);
 	bool SetTransition(const QString &chars, const char *transition, int duration, transitionType tt);
 	bool AddExcludeScene(QString dskName, const char *sceneName);
 	bool RemoveExcludeScene(QString dskName, const char *sceneName);
+	bool AddExcludeRule(QString dskName, const char *type, const char *pattern);
+	bool RemoveExcludeRule(QString dskName, const char *type, const char *pattern);
 
 	void ClearKeyers();
 	void AddDefaultKeyer();
@@ -39,7 +74,8 @@ private:
 	void AddExcludeSceneMenu(QMenu *tm);
 private slots:
 	void SceneChanged();
-	void Add(QString name = "");
+	void ChannelChanged();
+	bool Add(QString name = "");
 	void Rename();
 	void Remove(int index = -1);
 
@@ -50,22 +86,44 @@ public:
 
 	void SetTransitions(get_transitions_callback_t get_transitions = nullptr, void *get_transitions_data = nullptr);
 
+	static void SetSharedSceneHotkeys(bool shared);
+	static void PublishState();
+	static void RefreshStateSnapshot();
+
 	inline obs_view_t *GetView() { return view; }
 	inline obs_canvas_t *GetCanvas() { return obs_weak_canvas_get_canvas(canvas); }
 
 	static void frontend_event(enum obs_frontend_event event, void *data);
 	static void frontend_save_load(obs_data_t *save_data, bool saving, void *data);
 
+	// callable from any thread but the graphics and audio threads, they block until the UI thread has run them
+	static void proc_select_scene(void *data, calldata_t *cd);
+	static void proc_cue_scene(void *data, calldata_t *cd);
+	static void proc_take(void *data, calldata_t *cd);
+	static void proc_set_tie(void *data, calldata_t *cd);
+	static void proc_set_transition(void *data, calldata_t *cd);
+	static void proc_get_state(void *data, calldata_t *cd);
+
 	static void get_downstream_keyers(obs_data_t *request_data, obs_data_t *response_data, void *param);
 	static void get_downstream_keyer(obs_data_t *request_data, obs_data_t *response_data, void *param);
 	static void add_downstream_keyer(obs_data_t *request_data, obs_data_t *response_data, void *param);
 	static void remove_downstream_keyer(obs_data_t *request_data, obs_data_t *response_data, void *param);
 	static void get_scene(obs_data_t *request_data, obs_data_t *response_data, void *param);
 	static void change_scene(obs_data_t *request_data, obs_data_t *response_data, void *param);
+	static void cue_scene(obs_data_t *request_data, obs_data_t *response_data, void *param);
+	static void take(obs_data_t *request_data, obs_data_t *response_data, void *param);
+	static void get_state(obs_data_t *request_data, obs_data_t *response_data, void *param);
+	static void query(obs_data_t *request_data, obs_data_t *response_data, void *param);
+	static void subscribe(obs_data_t *request_data, obs_data_t *response_data, void *param);
+	static void unsubscribe(obs_data_t *request_data, obs_data_t *response_data, void *param);
+	static void set_event_coalescing(obs_data_t *request_data, obs_data_t *response_data, void *param);
 	static void add_scene(obs_data_t *request_data, obs_data_t *response_data, void *param);
 	static void remove_scene(obs_data_t *request_data, obs_data_t *response_data, void *param);
+	static void set_scenes(obs_data_t *request_data, obs_data_t *response_data, void *param);
 	static void set_tie(obs_data_t *request_data, obs_data_t *response_data, void *param);
 	static void set_transition(obs_data_t *request_data, obs_data_t *response_data, void *param);
 	static void add_exclude_scene(obs_data_t *request_data, obs_data_t *response_data, void *param);
 	static void remove_exclude_scene(obs_data_t *request_data, obs_data_t *response_data, void *param);
+	static void add_exclude_rule(obs_data_t *request_data, obs_data_t *response_data, void *param);
+	static void remove_exclude_rule(obs_data_t *request_data, obs_data_t *response_data, void *param);
 };
@@ -2,14 +2,19 @@
 
 #include <QCheckBox>
 #include <QComboBox>
+#include <QHash>
 #include <QLabel>
 #include <QLineEdit>
 #include <QListWidget>
+#include <QMenu>
 #include <QPushButton>
+#include <QSet>
 #include <QSpinBox>
 #include <QToolBar>
 #include <QVBoxLayout>
+#include <algorithm>
 #include <obs-frontend-api.h>
+#include <util/platform.h>
 
 #include "obs-module.h"
 
@@ -18,6 +23,162 @@
 
 extern obs_websocket_vendor vendor;
 
+struct active_scene {
+	bool valid;
+	obs_weak_source_t *scene;
+};
+
+static std::map<void *, active_scene> active_scenes;
+static std::mutex active_scenes_mutex;
+
+static obs_source_t *resolve_active_scene(obs_view_t *view, obs_canvas_t *canvas)
+{
+	if (!view && !canvas)
+		return obs_frontend_get_current_scene();
+	obs_source_t *source = view				 ? obs_view_get_source(view, 0)
+			       : obs_canvas_removed(canvas) ? nullptr
+							    : obs_canvas_get_channel(canvas, 0);
+	while (source && obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION) {
+		obs_source_t *ts = obs_transition_get_active_source(source);
+		if (ts) {
+			obs_source_release(source);
+			source = ts;
+		} else {
+			break;
+		}
+	}
+	if (source && obs_source_is_scene(source))
+		return source;
+	obs_source_release(source);
+	return nullptr;
+}
+
+obs_source_t *GetActiveScene(obs_view_t *view, obs_canvas_t *canvas)
+{
+	// views have no channel change signal to invalidate a cached scene, always walk their channel 0
+	if (view)
+		return resolve_active_scene(view, canvas);
+	void *key = (void *)canvas;
+	{
+		std::lock_guard<std::mutex> lock(active_scenes_mutex);
+		auto it = active_scenes.find(key);
+		if (it != active_scenes.end() && it->second.valid)
+			return obs_weak_source_get_source(it->second.scene);
+	}
+	obs_source_t *scene = resolve_active_scene(view, canvas);
+	std::lock_guard<std::mutex> lock(active_scenes_mutex);
+	auto &entry = active_scenes[key];
+	obs_weak_source_release(entry.scene);
+	entry.scene = obs_source_get_weak_source(scene);
+	entry.valid = true;
+	return scene;
+}
+
+void InvalidateActiveScene(void *view_or_canvas)
+{
+	std::lock_guard<std::mutex> lock(active_scenes_mutex);
+	auto it = active_scenes.find(view_or_canvas);
+	if (it != active_scenes.end())
+		it->second.valid = false;
+}
+
+void InvalidateActiveScenes()
+{
+	std::lock_guard<std::mutex> lock(active_scenes_mutex);
+	for (auto &it : active_scenes)
+		it.second.valid = false;
+}
+
+void ClearActiveScenes()
+{
+	std::lock_guard<std::mutex> lock(active_scenes_mutex);
+	for (auto &it : active_scenes)
+		obs_weak_source_release(it.second.scene);
+	active_scenes.clear();
+}
+
+struct event_subscription {
+	std::string view_name;
+	std::string dsk_name;
+	std::set<std::string> events;
+	uint64_t expires;
+};
+
+static std::map<std::string, event_subscription> event_subscriptions;
+static std::atomic<int> event_coalescing = 0;
+static std::mutex event_subscriptions_mutex;
+
+// a client that disconnects without unsubscribing is forgotten once its subscription expires
+static void ExpireEventSubscriptions(uint64_t now)
+{
+	for (auto it = event_subscriptions.begin(); it != event_subscriptions.end();) {
+		if (it->second.expires <= now)
+			it = event_subscriptions.erase(it);
+		else
+			it++;
+	}
+}
+
+void SubscribeEvents(const char *subscriber, const char *view_name, const char *dsk_name, const std::vector<std::string> &events,
+		     int ttl_seconds)
+{
+	const uint64_t now = os_gettime_ns();
+	std::lock_guard<std::mutex> lock(event_subscriptions_mutex);
+	ExpireEventSubscriptions(now);
+	auto &subscription = event_subscriptions[subscriber];
+	subscription.view_name = view_name ? view_name : "";
+	subscription.dsk_name = dsk_name ? dsk_name : "";
+	subscription.events = std::set<std::string>(events.begin(), events.end());
+	subscription.expires = now + (uint64_t)ttl_seconds * 1000000000ULL;
+}
+
+bool UnsubscribeEvents(const char *subscriber)
+{
+	std::lock_guard<std::mutex> lock(event_subscriptions_mutex);
+	return event_subscriptions.erase(subscriber) > 0;
+}
+
+// sets "filtered" and the matching "subscribers" while subscriptions exist, subscribed clients skip events without their id
+void AddEventSubscribers(obs_data_t *data, const char *event, const std::string &view_name, const char *dsk_name)
+{
+	std::lock_guard<std::mutex> lock(event_subscriptions_mutex);
+	if (event_subscriptions.empty())
+		return;
+	ExpireEventSubscriptions(os_gettime_ns());
+	if (event_subscriptions.empty())
+		return;
+	obs_data_array_t *subscribers = obs_data_array_create();
+	for (const auto &it : event_subscriptions) {
+		const auto &subscription = it.second;
+		if (!subscription.events.empty() && subscription.events.count(event) == 0)
+			continue;
+		if (!subscription.dsk_name.empty() && subscription.dsk_name != dsk_name)
+			continue;
+		if (subscription.view_name != view_name && !(subscription.view_name == "*"))
+			continue;
+		obs_data_t *item = obs_data_create();
+		obs_data_set_string(item, "subscriber", it.first.c_str());
+		obs_data_array_push_back(subscribers, item);
+		obs_data_release(item);
+	}
+	obs_data_set_bool(data, "filtered", true);
+	obs_data_set_array(data, "subscribers", subscribers);
+	obs_data_array_release(subscribers);
+}
+
+void SetEventCoalescing(int window_ms)
+{
+	event_coalescing = window_ms > 0 ? window_ms : 0;
+}
+
+int GetEventCoalescing()
+{
+	return event_coalescing;
+}
+
+// ids stay the same across renames and reorders, unlike the name or the tab index
+static std::atomic<uint32_t> next_keyer_id = 0;
+
 DownstreamKeyer::DownstreamKeyer(int channel, QString name, obs_view_t *v, obs_canvas_t *c, get_transitions_callback_t gt,
 				 void *gtd)
 	: outputChannel(channel),
@@ -33,6 +194,7 @@ DownstreamKeyer::DownstreamKeyer(int channel, QString name, obs_view_t *v, obs_c
 	  get_transitions(gt),
 	  get_transitions_data(gtd)
 {
+	id = ++next_keyer_id;
 	setObjectName(name);
 	auto layout = new QVBoxLayout(this);
 	layout->setSpacing(0);
@@ -53,6 +215,13 @@ DownstreamKeyer::DownstreamKeyer(int channel, QString name, obs_view_t *v, obs_c
 	scenesList->setDragDropMode(QAbstractItemView::InternalMove);
 	scenesList->setDefaultDropAction(Qt::TargetMoveAction);
 	connect(scenesList, SIGNAL(itemSelectionChanged()), this, SLOT(on_scenesList_itemSelectionChanged()));
+	connect(scenesList, &QListWidget::customContextMenuRequested, this, &DownstreamKeyer::scenesList_contextMenu);
+	connect(scenesList, &QListWidget::itemSelectionChanged, [this]() { dirty = true; });
+	connect(scenesList, &QListWidget::currentRowChanged, [this]() { dirty = true; });
+	connect(scenesList->model(), &QAbstractItemModel::rowsInserted, [this]() { dirty = true; });
+	connect(scenesList->model(), &QAbstractItemModel::rowsRemoved, [this]() { dirty = true; });
+	connect(scenesList->model(), &QAbstractItemModel::rowsMoved, [this]() { dirty = true; });
+	connect(scenesList->model(), &QAbstractItemModel::dataChanged, [this]() { dirty = true; });
 
 	layout->addWidget(scenesList);
 
@@ -111,6 +280,10 @@ DownstreamKeyer::DownstreamKeyer(int channel, QString name, obs_view_t *v, obs_c
 	tie = new LockedCheckBox(this);
 	tie->setObjectName(QStringLiteral("tie"));
 	tie->setToolTip(QT_UTF8(obs_module_text("Tie")));
+	connect(tie, &QCheckBox::toggled, [this]() {
+		dirty = true;
+		RequestStatePublish();
+	});
 	scenesToolbar->addWidget(tie);
 
 	// Themes need the QAction dynamic properties
@@ -129,6 +302,7 @@ DownstreamKeyer::DownstreamKeyer(int channel, QString name, obs_view_t *v, obs_c
 	const auto sh = obs_get_signal_handler();
 	signal_handler_connect(sh, "source_rename", source_rename, this);
 	signal_handler_connect(sh, "source_remove", source_remove, this);
+	signal_handler_connect(sh, "hotkey_bindings_changed", hotkey_bindings_changed, this);
 
 	setLayout(layout);
 	QString disableDskHotkeyName = QT_UTF8(obs_module_text("DisableDSK"));
@@ -148,15 +322,33 @@ DownstreamKeyer::DownstreamKeyer(int channel, QString name, obs_view_t *v, obs_c
 							  QT_TO_UTF8(disableTieHotkeyName), QT_TO_UTF8(disableTieHotkeyName),
 							  enable_tie_hotkey, disable_tie_hotkey, this, this);
 
+	sceneEventTimer.setSingleShot(true);
+	connect(&sceneEventTimer, &QTimer::timeout, [this]() {
+		EmitSceneChangedEvent(pendingOldScene.c_str(), pendingNewScene.c_str(), coalescedSceneEvents);
+	});
+
 	connect(&hideTimer, &QTimer::timeout, [this]() {
 		hideTimer.stop();
 		on_actionSceneNull_triggered();
 	});
+
+	// readiness depends on decoded frames, nothing signals it, so poll until it flips and republish the state
+	readyTimer.setInterval(100);
+	connect(&readyTimer, &QTimer::timeout, [this]() {
+		if (preloadTransitions && !TransitionsReady())
+			return;
+		readyTimer.stop();
+		RequestStatePublish();
+	});
 }
 
 DownstreamKeyer::~DownstreamKeyer()
 {
-	if (view) {
+	if (compositeSlot) {
+		obs_transition_set(compositeSlot, nullptr);
+		obs_source_release(compositeSlot);
+		compositeSlot = nullptr;
+	} else if (view) {
 		//obs_view_set_source(view, outputChannel, nullptr);
 	} else if (canvas) {
 		//obs_canvas_set_channel(canvas, outputChannel, nullptr);
@@ -167,21 +359,29 @@ DownstreamKeyer::~DownstreamKeyer()
 	obs_hotkey_pair_unregister(tie_hotkey_id);
 
 	if (transition) {
+		DisconnectTransitionSignals(transition);
+		CoolTransition(transition);
 		obs_transition_clear(transition);
 		obs_source_release(transition);
 		transition = nullptr;
 	}
 	if (showTransition) {
+		DisconnectTransitionSignals(showTransition);
+		CoolTransition(showTransition);
 		obs_transition_clear(showTransition);
 		obs_source_release(showTransition);
 		showTransition = nullptr;
 	}
 	if (hideTransition) {
+		DisconnectTransitionSignals(hideTransition);
+		CoolTransition(hideTransition);
 		obs_transition_clear(hideTransition);
 		obs_source_release(hideTransition);
 		hideTransition = nullptr;
 	}
 	if (overrideTransition) {
+		DisconnectTransitionSignals(overrideTransition);
+		CoolTransition(overrideTransition);
 		obs_transition_clear(overrideTransition);
 		obs_source_release(overrideTransition);
 		overrideTransition = nullptr;
@@ -189,12 +389,19 @@ DownstreamKeyer::~DownstreamKeyer()
 	const auto sh = obs_get_signal_handler();
 	signal_handler_disconnect(sh, "source_rename", source_rename, this);
 	signal_handler_disconnect(sh, "source_remove", source_remove, this);
+	signal_handler_disconnect(sh, "hotkey_bindings_changed", hotkey_bindings_changed, this);
+	obs_data_release(saveData);
+	ClearExcludeScenes();
 	while (scenesList->count()) {
 		const auto item = scenesList->item(0);
 		scenesList->removeItemWidget(item);
-		obs_hotkey_pair_unregister(item->data(Qt::UserRole).toUInt());
+		UnregisterSceneHotkey(item);
 		delete item;
 	}
+	ClearCue();
+	for (auto &cache : staticCaches)
+		obs_source_release(cache.second);
+	staticCaches.clear();
 	delete scenesList;
 	delete scenesToolbar;
 }
@@ -202,38 +409,8 @@ DownstreamKeyer::~DownstreamKeyer()
 void DownstreamKeyer::on_actionAddScene_triggered()
 {
 	obs_source_t *scene = nullptr;
-	if (view) {
-		obs_source_t *source = obs_view_get_source(view, 0);
-		while (source && obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION) {
-			obs_source_t *ts = obs_transition_get_active_source(source);
-			if (ts) {
-				obs_source_release(source);
-				source = ts;
-			} else {
-				break;
-			}
-		}
-		if (source && obs_source_is_scene(source)) {
-			scene = source;
-		} else {
-			obs_source_release(source);
-		}
-	} else if (canvas) {
-		obs_source_t *source = obs_canvas_get_channel(canvas, 0);
-		while (source && obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION) {
-			obs_source_t *ts = obs_transition_get_active_source(source);
-			if (ts) {
-				obs_source_release(source);
-				source = ts;
-			} else {
-				break;
-			}
-		}
-		if (source && obs_source_is_scene(source)) {
-			scene = source;
-		} else {
-			obs_source_release(source);
-		}
+	if (view || canvas) {
+		scene = GetActiveScene(view, canvas);
 	} else {
 		scene = obs_frontend_preview_program_mode_active() ? obs_frontend_get_current_preview_scene()
 								   : obs_frontend_get_current_scene();
@@ -255,7 +432,7 @@ void DownstreamKeyer::on_actionRemoveScene_triggered()
 	if (!item)
 		return;
 	scenesList->removeItemWidget(item);
-	obs_hotkey_pair_unregister(item->data(Qt::UserRole).toUInt());
+	UnregisterSceneHotkey(item);
 	delete item;
 }
 
@@ -278,16 +455,16 @@ void DownstreamKeyer::on_actionSceneNull_triggered()
 	scenesList->setCurrentRow(-1);
 }
 
-void DownstreamKeyer::apply_source(obs_source_t *const newSource)
+void DownstreamKeyer::apply_source(obs_source_t *const scene)
 {
+	Materialize();
+	obs_source_t *newSource = GetRenderSource(scene);
 	if (newSource && hideAfter > 0) {
 		hideTimer.stop();
 		hideTimer.setInterval(hideAfter);
 		hideTimer.start();
 	}
-	obs_source_t *prevSource = view     ? obs_view_get_source(view, outputChannel)
-				   : canvas ? obs_canvas_get_channel(canvas, outputChannel)
-					    : obs_get_output_source(outputChannel);
+	obs_source_t *prevSource = GetChannelSource();
 	obs_source_t *prevTransition = nullptr;
 	if (prevSource && obs_source_get_type(prevSource) == OBS_SOURCE_TYPE_TRANSITION) {
 		prevTransition = prevSource;
@@ -325,41 +502,68 @@ void DownstreamKeyer::apply_source(obs_source_t *const newSource)
 		//skip if nothing changed
 	} else {
 		if (!newTransition) {
-			if (view) {
-				obs_view_set_source(view, outputChannel, newSource);
-			} else if (canvas) {
-				obs_canvas_set_channel(canvas, outputChannel, newSource);
-			} else {
-				obs_set_output_source(outputChannel, newSource);
-			}
+			SetChannelSource(newSource);
 		} else {
 			obs_transition_set(newTransition, prevSource);
 
 			obs_transition_start(newTransition, OBS_TRANSITION_MODE_AUTO, newTransitionDuration, newSource);
 
 			if (prevTransition != newTransition) {
-				if (view) {
-					obs_view_set_source(view, outputChannel, newTransition);
-				} else if (canvas) {
-					obs_canvas_set_channel(canvas, outputChannel, newTransition);
-				} else {
-					obs_set_output_source(outputChannel, newTransition);
-				}
+				SetChannelSource(newTransition);
 			}
 		}
-		if (vendor) {
-			const auto data = obs_data_create();
-			obs_data_set_string(data, "dsk_name", QT_TO_UTF8(objectName()));
-			obs_data_set_int(data, "dsk_channel", outputChannel);
-			obs_data_set_string(data, "new_scene", newSource ? obs_source_get_name(newSource) : "");
-			obs_data_set_string(data, "old_scene", prevSource ? obs_source_get_name(prevSource) : "");
-			obs_websocket_vendor_emit_event(vendor, "dsk_scene_changed", data);
-			obs_data_release(data);
-		}
+		EmitSceneChanged(prevSource, newSource);
+		RequestStatePublish();
 	}
 
 	obs_source_release(prevSource);
 	obs_source_release(prevTransition);
+	obs_source_release(newSource);
+}
+
+void DownstreamKeyer::EmitSceneChanged(obs_source_t *prevSource, obs_source_t *newSource)
+{
+	// subscribers are matched once, when the (possibly merged) event is emitted
+	if (!vendor)
+		return;
+	const char *old_scene = prevSource ? obs_source_get_name(prevSource) : "";
+	const char *new_scene = newSource ? obs_source_get_name(newSource) : "";
+	const int window = GetEventCoalescing();
+	if (window <= 0) {
+		EmitSceneChangedEvent(old_scene, new_scene, 0);
+		return;
+	}
+	// merge rapid changes into one event going from the first old scene to the final new scene
+	if (sceneEventTimer.isActive()) {
+		coalescedSceneEvents++;
+	} else {
+		pendingOldScene = old_scene;
+		coalescedSceneEvents = 0;
+		sceneEventTimer.start(window);
+	}
+	pendingNewScene = new_scene;
+}
+
+void DownstreamKeyer::EmitSceneChangedEvent(const char *old_scene, const char *new_scene, int coalesced)
+{
+	if (!vendor)
+		return;
+	const auto data = obs_data_create();
+	obs_data_set_string(data, "dsk_name", QT_TO_UTF8(objectName()));
+	obs_data_set_int(data, "dsk_channel", outputChannel);
+	obs_data_set_string(data, "view_name", viewName.c_str());
+	obs_data_set_string(data, "new_scene", new_scene);
+	obs_data_set_string(data, "old_scene", old_scene);
+	if (coalesced)
+		obs_data_set_int(data, "coalesced", coalesced);
+	AddEventSubscribers(data, "dsk_scene_changed", viewName, QT_TO_UTF8(objectName()));
+	obs_websocket_vendor_emit_event(vendor, "dsk_scene_changed", data);
+	obs_data_release(data);
+}
+
+void DownstreamKeyer::SetViewName(const char *view_name)
+{
+	viewName = view_name ? view_name : "";
 }
 
 void DownstreamKeyer::apply_selected_source()
@@ -399,15 +603,34 @@ void DownstreamKeyer::ChangeSceneIndex(bool relative, int offset, int invalidIdx
 	scenesList->blockSignals(false);
 }
 
+static QString bindings_to_json(obs_data_array_t *bindings)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_set_array(data, "bindings", bindings);
+	const QString json = QT_UTF8(obs_data_get_json(data));
+	obs_data_release(data);
+	return json;
+}
+
+static obs_data_array_t *bindings_from_json(const QString &json)
+{
+	obs_data_t *data = obs_data_create_from_json(QT_TO_UTF8(json));
+	obs_data_array_t *bindings = data ? obs_data_get_array(data, "bindings") : nullptr;
+	obs_data_release(data);
+	return bindings ? bindings : obs_data_array_create();
+}
+
 void DownstreamKeyer::Save(obs_data_t *data)
 {
-	obs_data_set_string(data, "transition", transition ? obs_source_get_name(transition) : "");
+	obs_data_set_string(data, "transition", GetTransition(transitionType::match).c_str());
 	obs_data_set_int(data, "transition_duration", transitionDuration);
-	obs_data_set_string(data, "show_transition", showTransition ? obs_source_get_name(showTransition) : "");
+	obs_data_set_string(data, "show_transition", GetTransition(transitionType::show).c_str());
 	obs_data_set_int(data, "show_transition_duration", showTransitionDuration);
-	obs_data_set_string(data, "hide_transition", hideTransition ? obs_source_get_name(hideTransition) : "");
+	obs_data_set_string(data, "hide_transition", GetTransition(transitionType::hide).c_str());
 	obs_data_set_int(data, "hide_transition_duration", hideTransitionDuration);
 	obs_data_set_int(data, "hide_after", hideAfter);
+	obs_data_set_bool(data, "preload_transitions", preloadTransitions);
+	obs_data_set_int(data, "channel", outputChannel);
 	obs_data_set_bool(data, "tie", tie->isChecked());
 	obs_data_array_t *sceneArray = obs_data_array_create();
 	for (int i = 0; i < scenesList->count(); i++) {
@@ -416,6 +639,17 @@ void DownstreamKeyer::Save(obs_data_t *data)
 			continue;
 		auto sceneData = obs_data_create();
 		obs_data_set_string(sceneData, "name", QT_TO_UTF8(item->text()));
+		if (item->data(Qt::UserRole + 2).toBool())
+			obs_data_set_bool(sceneData, "static", true);
+		// own bindings of this keyer, kept while scene hotkeys are shared
+		if (item->data(Qt::UserRole + 3).isValid()) {
+			obs_data_array_t *eb = bindings_from_json(item->data(Qt::UserRole + 3).toString());
+			obs_data_array_t *db = bindings_from_json(item->data(Qt::UserRole + 4).toString());
+			obs_data_set_array(sceneData, "enable_hotkey", eb);
+			obs_data_set_array(sceneData, "disable_hotkey", db);
+			obs_data_array_release(eb);
+			obs_data_array_release(db);
+		}
 		obs_data_array_push_back(sceneArray, sceneData);
 		obs_data_release(sceneData);
 	}
@@ -434,18 +668,49 @@ void DownstreamKeyer::Save(obs_data_t *data)
 	obs_data_array_release(eth);
 	obs_data_array_release(dth);
 	auto excludes = obs_data_array_create();
-	for (auto t : exclude_scenes) {
+	for (auto &e : exclude_scenes) {
+		obs_source_t *source = obs_weak_source_get_source(e.source);
+		if (source)
+			e.name = obs_source_get_name(source);
+		obs_source_release(source);
 		const auto obj = obs_data_create();
-		obs_data_set_string(obj, "name", t.c_str());
+		obs_data_set_string(obj, "name", e.name.c_str());
+		if (!e.uuid.empty())
+			obs_data_set_string(obj, "uuid", e.uuid.c_str());
 		obs_data_array_push_back(excludes, obj);
 		obs_data_release(obj);
 	}
 	obs_data_set_array(data, "exclude_scenes", excludes);
 	obs_data_array_release(excludes);
+	auto rules = obs_data_array_create();
+	for (const auto &r : exclude_rules) {
+		const auto obj = obs_data_create();
+		obs_data_set_string(obj, "type", r.first.c_str());
+		obs_data_set_string(obj, "pattern", r.second.c_str());
+		obs_data_array_push_back(rules, obj);
+		obs_data_release(obj);
+	}
+	obs_data_set_array(data, "exclude_rules", rules);
+	obs_data_array_release(rules);
+}
+
+obs_data_t *DownstreamKeyer::GetSaveData(const char *name)
+{
+	if (dirty || !saveData || strcmp(obs_data_get_string(saveData, "name"), name) != 0) {
+		obs_data_release(saveData);
+		saveData = obs_data_create();
+		obs_data_set_string(saveData, "name", name);
+		Save(saveData);
+		dirty = false;
+	}
+	obs_data_addref(saveData);
+	return saveData;
 }
 
 std::string DownstreamKeyer::GetTransition(enum transitionType transition_type)
 {
+	if (transition_type != transitionType::override && !pendingTransitions[transition_type].empty())
+		return pendingTransitions[transition_type];
 	if (transition_type == transitionType::match && transition)
 		return obs_source_get_name(transition);
 	if (transition_type == transitionType::show && showTransition)
@@ -457,8 +722,43 @@ std::string DownstreamKeyer::GetTransition(enum transitionType transition_type)
 	return "";
 }
 
+void DownstreamKeyer::SetPendingTransition(const char *transition_name, enum transitionType transition_type)
+{
+	obs_source_t *oldTransition = transition_type == transitionType::show   ? showTransition
+				      : transition_type == transitionType::hide ? hideTransition
+										: transition;
+	if (oldTransition || !transition_name || !strlen(transition_name)) {
+		SetTransition(transition_name, transition_type);
+		return;
+	}
+	pendingTransitions[transition_type] = transition_name;
+	transitionsPending = true;
+}
+
+void DownstreamKeyer::Materialize()
+{
+	if (!transitionsPending)
+		return;
+	transitionsPending = false;
+	for (int i = transitionType::match; i <= transitionType::hide; i++) {
+		if (pendingTransitions[i].empty())
+			continue;
+		const std::string name = pendingTransitions[i];
+		pendingTransitions[i].clear();
+		SetTransition(name.c_str(), (enum transitionType)i);
+	}
+}
+
+void DownstreamKeyer::SetTransitions(get_transitions_callback_t gt, void *gtd)
+{
+	get_transitions = gt;
+	get_transitions_data = gtd;
+}
+
 void DownstreamKeyer::SetTransition(const char *transition_name, enum transitionType transition_type)
 {
+	if (transition_type != transitionType::override)
+		pendingTransitions[transition_type].clear();
 	obs_source_t *oldTransition = transition;
 	if (transition_type == transitionType::show)
 		oldTransition = showTransition;
@@ -469,6 +769,9 @@ void DownstreamKeyer::SetTransition(const char *transition_name, enum transition
 
 	if (!oldTransition && (!transition_name || !strlen(transition_name)))
 		return;
+	if (transition_type != transitionType::override)
+		dirty = true;
+	RequestStatePublish();
 
 	obs_source_t *newTransition = nullptr;
 	obs_frontend_source_list transitions = {};
@@ -484,6 +787,10 @@ void DownstreamKeyer::SetTransition(const char *transition_name, enum transition
 		}
 	}
 	obs_frontend_source_list_free(&transitions);
+	if (newTransition)
+		ConnectTransitionSignals(newTransition);
+	if (newTransition && preloadTransitions && transition_type != transitionType::override)
+		WarmTransition(newTransition);
 
 	if (transition_type == transitionType::show)
 		showTransition = newTransition;
@@ -493,47 +800,31 @@ void DownstreamKeyer::SetTransition(const char *transition_name, enum transition
 		overrideTransition = newTransition;
 	else
 		transition = newTransition;
-	obs_source_t *prevSource = view     ? obs_view_get_source(view, outputChannel)
-				   : canvas ? obs_canvas_get_channel(canvas, outputChannel)
-					    : obs_get_output_source(outputChannel);
+	obs_source_t *prevSource = GetChannelSource();
 	if (oldTransition && prevSource == oldTransition) {
 		if (newTransition) {
 			//swap transition
 			obs_transition_swap_begin(newTransition, oldTransition);
-			if (view) {
-				obs_view_set_source(view, outputChannel, newTransition);
-			} else if (canvas) {
-				obs_canvas_set_channel(canvas, outputChannel, newTransition);
-			} else {
-				obs_set_output_source(outputChannel, newTransition);
-			}
+			SetChannelSource(newTransition);
 			obs_transition_swap_end(newTransition, oldTransition);
 		} else {
 			auto item = scenesList->currentItem();
 			if (item) {
 				auto scene = canvas ? obs_canvas_get_source_by_name(canvas, QT_TO_UTF8(item->text()))
 						    : obs_get_source_by_name(QT_TO_UTF8(item->text()));
-				if (view) {
-					obs_view_set_source(view, outputChannel, scene);
-				} else if (canvas) {
-					obs_canvas_set_channel(canvas, outputChannel, scene);
-				} else {
-					obs_set_output_source(outputChannel, scene);
-				}
+				auto renderSource = GetRenderSource(scene);
+				SetChannelSource(renderSource);
+				obs_source_release(renderSource);
 				obs_source_release(scene);
 			} else {
-				if (view) {
-					obs_view_set_source(view, outputChannel, nullptr);
-				} else if (canvas) {
-					obs_canvas_set_channel(canvas, outputChannel, nullptr);
-				} else {
-					obs_set_output_source(outputChannel, nullptr);
-				}
+				SetChannelSource(nullptr);
 			}
 		}
 	}
 	obs_source_release(prevSource);
 	if (oldTransition) {
+		DisconnectTransitionSignals(oldTransition);
+		CoolTransition(oldTransition);
 		obs_transition_clear(oldTransition);
 		obs_source_release(oldTransition);
 	}
@@ -541,6 +832,8 @@ void DownstreamKeyer::SetTransition(const char *transition_name, enum transition
 
 void DownstreamKeyer::SetTransitionDuration(int duration, enum transitionType transition_type)
 {
+	if (transition_type != transitionType::override)
+		dirty = true;
 	if (transition_type == match)
 		transitionDuration = duration;
 	else if (transition_type == transitionType::show)
@@ -549,6 +842,7 @@ void DownstreamKeyer::SetTransitionDuration(int duration, enum transitionType tr
 		hideTransitionDuration = duration;
 	else if (transition_type == transitionType::override)
 		overrideTransitionDuration = duration;
+	RequestStatePublish();
 }
 
 int DownstreamKeyer::GetTransitionDuration(enum transitionType transition_type)
@@ -565,6 +859,7 @@ int DownstreamKeyer::GetTransitionDuration(enum transitionType transition_type)
 void DownstreamKeyer::SetHideAfter(int duration)
 {
 	hideAfter = duration;
+	dirty = true;
 	if (duration == 0)
 		hideTimer.stop();
 }
@@ -574,21 +869,13 @@ int DownstreamKeyer::GetHideAfter()
 	return hideAfter;
 }
 
-void DownstreamKeyer::SceneChanged(std::string scene)
+void DownstreamKeyer::SceneChanged(obs_source_t *scene)
 {
-	auto found = false;
-	for (const auto &e : exclude_scenes) {
-		if (scene == e)
-			found = true;
-	}
-
-	if (found) {
+	if (IsSceneExcluded(scene)) {
 		apply_source(nullptr);
 		return;
 	} else {
-		obs_source_t *prevSource = view     ? obs_view_get_source(view, outputChannel)
-					   : canvas ? obs_canvas_get_channel(canvas, outputChannel)
-						    : obs_get_output_source(outputChannel);
+		obs_source_t *prevSource = GetChannelSource();
 		if (prevSource && obs_source_get_type(prevSource) == OBS_SOURCE_TYPE_TRANSITION) {
 			obs_source_t *prevTransition = prevSource;
 			prevSource = obs_transition_get_active_source(prevTransition);
@@ -609,13 +896,14 @@ void DownstreamKeyer::SceneChanged(std::string scene)
 
 void DownstreamKeyer::Load(obs_data_t *data)
 {
-	SetTransition(obs_data_get_string(data, "transition"));
+	SetPendingTransition(obs_data_get_string(data, "transition"), transitionType::match);
 	transitionDuration = obs_data_get_int(data, "transition_duration");
-	SetTransition(obs_data_get_string(data, "show_transition"), transitionType::show);
+	SetPendingTransition(obs_data_get_string(data, "show_transition"), transitionType::show);
 	showTransitionDuration = obs_data_get_int(data, "show_transition_duration");
-	SetTransition(obs_data_get_string(data, "hide_transition"), transitionType::hide);
+	SetPendingTransition(obs_data_get_string(data, "hide_transition"), transitionType::hide);
 	hideTransitionDuration = obs_data_get_int(data, "hide_transition_duration");
 	hideAfter = obs_data_get_int(data, "hide_after");
+	SetPreloadTransitions(obs_data_get_bool(data, "preload_transitions"));
 	tie->setChecked(obs_data_get_bool(data, "tie"));
 	scenesList->clear();
 	obs_data_array_t *sceneArray = obs_data_get_array(data, "scenes");
@@ -627,17 +915,23 @@ void DownstreamKeyer::Load(obs_data_t *data)
 			const auto source_name = obs_data_get_string(sceneData, "name");
 			const auto item = new QListWidgetItem(QT_UTF8(source_name));
 			scenesList->addItem(item);
+			if (obs_data_get_bool(sceneData, "static"))
+				item->setData(Qt::UserRole + 2, true);
+			obs_data_array_t *eb = obs_data_get_array(sceneData, "enable_hotkey");
+			obs_data_array_t *db = obs_data_get_array(sceneData, "disable_hotkey");
+			if (sharedSceneHotkeys && eb && db) {
+				item->setData(Qt::UserRole + 3, bindings_to_json(eb));
+				item->setData(Qt::UserRole + 4, bindings_to_json(db));
+			}
+			obs_data_array_release(eb);
+			obs_data_array_release(db);
 			obs_source_t *source = canvas ? obs_canvas_get_source_by_name(canvas, source_name)
 						      : obs_get_source_by_name(source_name);
 			if (item->text() == sceneName) {
 				if (source) {
-					if (view) {
-						obs_view_set_source(view, outputChannel, source);
-					} else if (canvas) {
-						obs_canvas_set_channel(canvas, outputChannel, source);
-					} else {
-						obs_set_output_source(outputChannel, source);
-					}
+					auto renderSource = GetRenderSource(source);
+					SetChannelSource(renderSource);
+					obs_source_release(renderSource);
 				}
 				scenesList->setCurrentItem(item);
 				item->setSelected(true);
@@ -645,19 +939,7 @@ void DownstreamKeyer::Load(obs_data_t *data)
 			obs_data_release(sceneData);
 
 			if (source) {
-				std::string enable_hotkey = obs_module_text("EnableDSK");
-				enable_hotkey += " ";
-				enable_hotkey += QT_TO_UTF8(objectName());
-				std::string disable_hotkey = obs_module_text("DisableDSK");
-				disable_hotkey += " ";
-				disable_hotkey += QT_TO_UTF8(objectName());
-				uint64_t h = obs_hotkey_pair_register_source(source, enable_hotkey.c_str(), enable_hotkey.c_str(),
-									     disable_hotkey.c_str(), disable_hotkey.c_str(),
-									     enable_DSK_hotkey, disable_DSK_hotkey, this, this);
-
-				if (h != OBS_INVALID_HOTKEY_PAIR_ID) {
-					item->setData(Qt::UserRole, static_cast<uint>(h));
-				}
+				RegisterSceneHotkey(item, source);
 				obs_source_release(source);
 			}
 		}
@@ -681,16 +963,29 @@ void DownstreamKeyer::Load(obs_data_t *data)
 	obs_data_array_release(dth);
 
 	auto excludes = obs_data_get_array(data, "exclude_scenes");
-	exclude_scenes.clear();
+	ClearExcludeScenes();
 	if (excludes) {
 		auto count = obs_data_array_count(excludes);
 		for (size_t i = 0; i < count; i++) {
 			const auto sceneData = obs_data_array_item(excludes, i);
-			exclude_scenes.emplace(obs_data_get_string(sceneData, "name"));
+			AddExcludeSource(obs_data_get_string(sceneData, "uuid"), obs_data_get_string(sceneData, "name"));
 			obs_data_release(sceneData);
 		}
 		obs_data_array_release(excludes);
 	}
+	exclude_rules.clear();
+	auto rules = obs_data_get_array(data, "exclude_rules");
+	if (rules) {
+		auto count = obs_data_array_count(rules);
+		for (size_t i = 0; i < count; i++) {
+			const auto ruleData = obs_data_array_item(rules, i);
+			exclude_rules.emplace_back(obs_data_get_string(ruleData, "type"), obs_data_get_string(ruleData, "pattern"));
+			obs_data_release(ruleData);
+		}
+		obs_data_array_release(rules);
+	}
+	CompileExcludeRules();
+	dirty = true;
 }
 
 void DownstreamKeyer::source_rename(void *data, calldata_t *calldata)
@@ -698,28 +993,251 @@ void DownstreamKeyer::source_rename(void *data, calldata_t *calldata)
 	const auto downstreamKeyer = static_cast<DownstreamKeyer *>(data);
 	const auto newName = QT_UTF8(calldata_string(calldata, "new_name"));
 	const auto prevName = QT_UTF8(calldata_string(calldata, "prev_name"));
+	const auto source = static_cast<obs_source_t *>(calldata_ptr(calldata, "source"));
+	downstreamKeyer->exclude_rules_cache.erase(source);
+	// excluded scenes are saved by name too
+	const auto excluded = downstreamKeyer->exclude_sources.find(source);
+	if (excluded != downstreamKeyer->exclude_sources.end()) {
+		for (auto &e : downstreamKeyer->exclude_scenes) {
+			if (e.source == excluded->second)
+				e.name = calldata_string(calldata, "new_name");
+		}
+		downstreamKeyer->dirty = true;
+	}
 	const auto count = downstreamKeyer->scenesList->count();
 	for (int i = 0; i < count; i++) {
 		const auto item = downstreamKeyer->scenesList->item(i);
-		if (item->text() == prevName)
+		if (item->text() == prevName) {
 			item->setText(newName);
+			downstreamKeyer->dirty = true;
+		}
 	}
 }
 
 void DownstreamKeyer::source_remove(void *data, calldata_t *calldata)
 {
 	const auto downstreamKeyer = static_cast<DownstreamKeyer *>(data);
+	const auto excluded = downstreamKeyer->exclude_sources.find(static_cast<obs_source_t *>(calldata_ptr(calldata, "source")));
+	if (excluded != downstreamKeyer->exclude_sources.end()) {
+		downstreamKeyer->exclude_sources.erase(excluded);
+		downstreamKeyer->dirty = true;
+	}
+	downstreamKeyer->exclude_rules_cache.erase(static_cast<obs_source_t *>(calldata_ptr(calldata, "source")));
+	downstreamKeyer->ReleaseStaticCache(static_cast<obs_source_t *>(calldata_ptr(calldata, "source")));
 	const auto name = QT_UTF8(obs_source_get_name(static_cast<obs_source_t *>(calldata_ptr(calldata, "source"))));
+	if (downstreamKeyer->GetCuedScene() == name)
+		downstreamKeyer->ClearCue();
 
 	const auto count = downstreamKeyer->scenesList->count();
 	for (int i = count - 1; i >= 0; i--) {
 		const auto item = downstreamKeyer->scenesList->item(i);
 		if (item->text() == name) {
 			downstreamKeyer->scenesList->removeItemWidget(item);
-			obs_hotkey_pair_unregister(item->data(Qt::UserRole).toUInt());
+			UnregisterSceneHotkey(item);
 			delete item;
+			downstreamKeyer->dirty = true;
+		}
+	}
+}
+
+bool DownstreamKeyer::sharedSceneHotkeys = false;
+std::map<obs_source_t *, DownstreamKeyer::SceneHotkeyRoute> DownstreamKeyer::sceneHotkeyRoutes;
+std::mutex DownstreamKeyer::sceneHotkeyRoutesMutex;
+
+static void append_hotkey_bindings(obs_data_array_t *target, obs_data_array_t *bindings)
+{
+	const size_t count = obs_data_array_count(bindings);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *binding = obs_data_array_item(bindings, i);
+		obs_data_array_push_back(target, binding);
+		obs_data_release(binding);
+	}
+}
+
+void DownstreamKeyer::RegisterSceneHotkey(QListWidgetItem *item, obs_source_t *source, obs_data_array_t *enable_bindings,
+					  obs_data_array_t *disable_bindings)
+{
+	if (!sharedSceneHotkeys) {
+		std::string enable_hotkey = obs_module_text("EnableDSK");
+		enable_hotkey += " ";
+		enable_hotkey += QT_TO_UTF8(objectName());
+		std::string disable_hotkey = obs_module_text("DisableDSK");
+		disable_hotkey += " ";
+		disable_hotkey += QT_TO_UTF8(objectName());
+		obs_hotkey_pair_id h = obs_hotkey_pair_register_source(source, enable_hotkey.c_str(), enable_hotkey.c_str(),
+								       disable_hotkey.c_str(), disable_hotkey.c_str(),
+								       enable_DSK_hotkey, disable_DSK_hotkey, this, this);
+
+		if (h != OBS_INVALID_HOTKEY_PAIR_ID) {
+			item->setData(Qt::UserRole, static_cast<uint>(h));
+			item->setData(Qt::UserRole + 1, false);
+			if (enable_bindings && disable_bindings)
+				obs_hotkey_pair_load(h, enable_bindings, disable_bindings);
+		}
+		return;
+	}
+
+	obs_hotkey_pair_id h = OBS_INVALID_HOTKEY_PAIR_ID;
+	bool created = false;
+	{
+		std::lock_guard<std::mutex> lock(sceneHotkeyRoutesMutex);
+		auto it = sceneHotkeyRoutes.find(source);
+		if (it != sceneHotkeyRoutes.end()) {
+			it->second.keyers.push_back(this);
+			h = it->second.id;
 		}
 	}
+	if (h == OBS_INVALID_HOTKEY_PAIR_ID) {
+		const char *enable_hotkey = obs_module_text("EnableDSKShared");
+		const char *disable_hotkey = obs_module_text("DisableDSKShared");
+		h = obs_hotkey_pair_register_source(source, enable_hotkey, enable_hotkey, disable_hotkey, disable_hotkey,
+						    enable_shared_DSK_hotkey, disable_shared_DSK_hotkey, source, source);
+		if (h == OBS_INVALID_HOTKEY_PAIR_ID)
+			return;
+		std::lock_guard<std::mutex> lock(sceneHotkeyRoutesMutex);
+		auto &route = sceneHotkeyRoutes[source];
+		route.id = h;
+		route.keyers.push_back(this);
+		created = true;
+	}
+	item->setData(Qt::UserRole, static_cast<uint>(h));
+	item->setData(Qt::UserRole + 1, true);
+
+	if (!enable_bindings || !disable_bindings)
+		return;
+	if (created) {
+		obs_hotkey_pair_load(h, enable_bindings, disable_bindings);
+		return;
+	}
+	// merge the bindings of this keyer into the bindings already routed for this scene
+	obs_data_array_t *eb = nullptr;
+	obs_data_array_t *db = nullptr;
+	obs_hotkey_pair_save(h, &eb, &db);
+	append_hotkey_bindings(eb, enable_bindings);
+	append_hotkey_bindings(db, disable_bindings);
+	obs_hotkey_pair_load(h, eb, db);
+	obs_data_array_release(eb);
+	obs_data_array_release(db);
+}
+
+void DownstreamKeyer::UnregisterSceneHotkey(QListWidgetItem *item)
+{
+	const auto data = item->data(Qt::UserRole);
+	if (!data.isValid())
+		return;
+	const obs_hotkey_pair_id h = data.toUInt();
+	item->setData(Qt::UserRole, QVariant());
+	if (!item->data(Qt::UserRole + 1).toBool()) {
+		obs_hotkey_pair_unregister(h);
+		return;
+	}
+	bool unused = false;
+	{
+		std::lock_guard<std::mutex> lock(sceneHotkeyRoutesMutex);
+		for (auto it = sceneHotkeyRoutes.begin(); it != sceneHotkeyRoutes.end(); it++) {
+			if (it->second.id != h)
+				continue;
+			auto &keyers = it->second.keyers;
+			auto k = std::find(keyers.begin(), keyers.end(), this);
+			if (k != keyers.end())
+				keyers.erase(k);
+			if (keyers.empty()) {
+				sceneHotkeyRoutes.erase(it);
+				unused = true;
+			}
+			break;
+		}
+	}
+	if (unused)
+		obs_hotkey_pair_unregister(h);
+}
+
+void DownstreamKeyer::SetSharedSceneHotkeys(bool shared, const std::vector<DownstreamKeyer *> &keyers)
+{
+	if (sharedSceneHotkeys == shared)
+		return;
+	struct migration {
+		DownstreamKeyer *keyer;
+		QListWidgetItem *item;
+		obs_data_array_t *enable_bindings;
+		obs_data_array_t *disable_bindings;
+	};
+	// Every keyer shares one pair per scene with the union of all bindings. The bindings each keyer had before are kept
+	// on its scene items (and saved with the keyer) so going back restores them instead of handing out the union.
+	std::vector<migration> migrations;
+	for (auto keyer : keyers) {
+		for (int i = 0; i < keyer->scenesList->count(); i++) {
+			auto item = keyer->scenesList->item(i);
+			const auto data = item->data(Qt::UserRole);
+			if (!data.isValid())
+				continue;
+			migration m = {keyer, item, nullptr, nullptr};
+			if (shared) {
+				obs_hotkey_pair_save(data.toUInt(), &m.enable_bindings, &m.disable_bindings);
+				item->setData(Qt::UserRole + 3, bindings_to_json(m.enable_bindings));
+				item->setData(Qt::UserRole + 4, bindings_to_json(m.disable_bindings));
+			} else {
+				if (item->data(Qt::UserRole + 3).isValid()) {
+					m.enable_bindings = bindings_from_json(item->data(Qt::UserRole + 3).toString());
+					m.disable_bindings = bindings_from_json(item->data(Qt::UserRole + 4).toString());
+				}
+				item->setData(Qt::UserRole + 3, QVariant());
+				item->setData(Qt::UserRole + 4, QVariant());
+			}
+			migrations.push_back(m);
+		}
+	}
+	for (auto &m : migrations)
+		m.keyer->UnregisterSceneHotkey(m.item);
+	sharedSceneHotkeys = shared;
+	for (auto &m : migrations) {
+		auto source = m.keyer->canvas ? obs_canvas_get_source_by_name(m.keyer->canvas, QT_TO_UTF8(m.item->text()))
+					      : obs_get_source_by_name(QT_TO_UTF8(m.item->text()));
+		if (source) {
+			m.keyer->RegisterSceneHotkey(m.item, source, m.enable_bindings, m.disable_bindings);
+			obs_source_release(source);
+		}
+		obs_data_array_release(m.enable_bindings);
+		obs_data_array_release(m.disable_bindings);
+		m.keyer->dirty = true;
+	}
+}
+
+bool DownstreamKeyer::GetSharedSceneHotkeys()
+{
+	return sharedSceneHotkeys;
+}
+
+bool DownstreamKeyer::enable_shared_DSK_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed)
+{
+	if (!pressed)
+		return false;
+	std::lock_guard<std::mutex> lock(sceneHotkeyRoutesMutex);
+	auto it = sceneHotkeyRoutes.find(static_cast<obs_source_t *>(data));
+	if (it == sceneHotkeyRoutes.end())
+		return false;
+	bool changed = false;
+	for (auto keyer : it->second.keyers) {
+		if (enable_DSK_hotkey(keyer, id, hotkey, pressed))
+			changed = true;
+	}
+	return changed;
+}
+
+bool DownstreamKeyer::disable_shared_DSK_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed)
+{
+	if (!pressed)
+		return false;
+	std::lock_guard<std::mutex> lock(sceneHotkeyRoutesMutex);
+	auto it = sceneHotkeyRoutes.find(static_cast<obs_source_t *>(data));
+	if (it == sceneHotkeyRoutes.end())
+		return false;
+	bool changed = false;
+	for (auto keyer : it->second.keyers) {
+		if (disable_DSK_hotkey(keyer, id, hotkey, pressed))
+			changed = true;
+	}
+	return changed;
 }
 
 bool DownstreamKeyer::enable_DSK_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed)
@@ -799,100 +1317,164 @@ bool DownstreamKeyer::disable_tie_hotkey(void *data, obs_hotkey_pair_id id, obs_
 	return true;
 }
 
-void DownstreamKeyer::AddExcludeScene(const char *scene_name)
+void DownstreamKeyer::AddExcludeSource(const char *uuid, const char *name)
 {
-	if (exclude_scenes.count(scene_name) > 0)
-		return;
-	exclude_scenes.emplace(scene_name);
-	obs_source_t *scene = nullptr;
-	if (view) {
-		obs_source_t *source = obs_view_get_source(view, 0);
-		while (source && obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION) {
-			obs_source_t *ts = obs_transition_get_active_source(source);
-			if (ts) {
-				obs_source_release(source);
-				source = ts;
-			} else {
-				break;
-			}
-		}
-		if (source && obs_source_is_scene(source)) {
-			scene = source;
-		} else {
-			obs_source_release(source);
-		}
-	} else if (canvas) {
-		obs_source_t *source = obs_canvas_get_channel(canvas, 0);
-		while (source && obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION) {
-			obs_source_t *ts = obs_transition_get_active_source(source);
-			if (ts) {
-				obs_source_release(source);
-				source = ts;
-			} else {
-				break;
-			}
+	obs_source_t *source = uuid && strlen(uuid) ? obs_get_source_by_uuid(uuid) : nullptr;
+	if (!source && name && strlen(name))
+		source = canvas ? obs_canvas_get_source_by_name(canvas, name) : obs_get_source_by_name(name);
+	excluded_scene e = {source ? obs_source_get_uuid(source) : (uuid ? uuid : ""),
+			    source ? obs_source_get_name(source) : (name ? name : ""), obs_source_get_weak_source(source)};
+	if (source)
+		exclude_sources[source] = e.source;
+	exclude_scenes.push_back(e);
+	obs_source_release(source);
+}
+
+void DownstreamKeyer::ClearExcludeScenes()
+{
+	for (auto &e : exclude_scenes)
+		obs_weak_source_release(e.source);
+	exclude_scenes.clear();
+	exclude_sources.clear();
+}
+
+void DownstreamKeyer::ExcludeSceneChanged(const char *scene_name)
+{
+	obs_source_t *scene = GetActiveScene(view, canvas);
+	const char *sn = obs_source_get_name(scene);
+	if (!scene_name || (sn && strcmp(sn, scene_name) == 0))
+		SceneChanged(scene);
+	obs_source_release(scene);
+}
+
+static QString exclude_rule_expression(const std::string &type, const std::string &pattern)
+{
+	const auto p = QT_UTF8(pattern.c_str());
+	if (type == "glob")
+		return QRegularExpression::wildcardToRegularExpression(p);
+	if (type == "regex")
+		return p;
+	if (type == "prefix")
+		return QStringLiteral("\\A") + QRegularExpression::escape(p);
+	return QString();
+}
+
+void DownstreamKeyer::CompileExcludeRules()
+{
+	// every rule keeps its own expression, joined into one alternation backreferences and group names would clash
+	exclude_rules_matchers.clear();
+	for (const auto &r : exclude_rules) {
+		const auto expression = exclude_rule_expression(r.first, r.second);
+		if (expression.isEmpty())
+			continue;
+		QRegularExpression matcher(expression);
+		if (!matcher.isValid())
+			continue;
+		matcher.optimize();
+		exclude_rules_matchers.push_back(matcher);
+	}
+	exclude_rules_cache.clear();
+}
+
+bool DownstreamKeyer::MatchesExcludeRules(obs_source_t *scene)
+{
+	if (exclude_rules_matchers.empty())
+		return false;
+	auto it = exclude_rules_cache.find(scene);
+	if (it != exclude_rules_cache.end())
+		return it->second;
+	const auto name = QT_UTF8(obs_source_get_name(scene));
+	bool match = false;
+	for (const auto &matcher : exclude_rules_matchers) {
+		if (matcher.match(name).hasMatch()) {
+			match = true;
+			break;
 		}
-		if (source && obs_source_is_scene(source)) {
-			scene = source;
-		} else {
-			obs_source_release(source);
+	}
+	exclude_rules_cache[scene] = match;
+	return match;
+}
+
+bool DownstreamKeyer::AddExcludeRule(const char *type, const char *pattern)
+{
+	if (!type || !pattern || !strlen(pattern))
+		return false;
+	const auto expression = exclude_rule_expression(type, pattern);
+	if (expression.isEmpty() || !QRegularExpression(expression).isValid())
+		return false;
+	for (const auto &r : exclude_rules) {
+		if (r.first == type && r.second == pattern)
+			return true;
+	}
+	exclude_rules.emplace_back(type, pattern);
+	CompileExcludeRules();
+	dirty = true;
+	ExcludeSceneChanged(nullptr);
+	return true;
+}
+
+bool DownstreamKeyer::RemoveExcludeRule(const char *type, const char *pattern)
+{
+	if (!type || !pattern)
+		return false;
+	for (auto it = exclude_rules.begin(); it != exclude_rules.end(); it++) {
+		if (it->first == type && it->second == pattern) {
+			exclude_rules.erase(it);
+			CompileExcludeRules();
+			dirty = true;
+			ExcludeSceneChanged(nullptr);
+			return true;
 		}
-	} else {
-		scene = obs_frontend_get_current_scene();
 	}
-	const auto sn = obs_source_get_name(scene);
-	if (strcmp(sn, scene_name) == 0)
-		SceneChanged(sn);
-	obs_source_release(scene);
+	return false;
+}
+
+std::vector<std::pair<std::string, std::string>> DownstreamKeyer::GetExcludeRules()
+{
+	return exclude_rules;
+}
+
+void DownstreamKeyer::AddExcludeScene(const char *scene_name)
+{
+	for (auto &e : exclude_scenes) {
+		obs_source_t *source = obs_weak_source_get_source(e.source);
+		const bool found = source ? strcmp(obs_source_get_name(source), scene_name) == 0 : e.name == scene_name;
+		obs_source_release(source);
+		if (found)
+			return;
+	}
+	AddExcludeSource(nullptr, scene_name);
+	dirty = true;
+	ExcludeSceneChanged(scene_name);
 }
 
 void DownstreamKeyer::RemoveExcludeScene(const char *scene_name)
 {
-	exclude_scenes.erase(scene_name);
-	obs_source_t *scene = nullptr;
-	if (view) {
-		obs_source_t *source = obs_view_get_source(view, 0);
-		while (source && obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION) {
-			obs_source_t *ts = obs_transition_get_active_source(source);
-			if (ts) {
-				obs_source_release(source);
-				source = ts;
-			} else {
-				break;
-			}
-		}
-		if (source && obs_source_is_scene(source)) {
-			scene = source;
-		} else {
-			obs_source_release(source);
+	for (auto it = exclude_scenes.begin(); it != exclude_scenes.end(); it++) {
+		obs_source_t *source = obs_weak_source_get_source(it->source);
+		const bool found = source ? strcmp(obs_source_get_name(source), scene_name) == 0 : it->name == scene_name;
+		if (found) {
+			if (source)
+				exclude_sources.erase(source);
+			obs_weak_source_release(it->source);
+			exclude_scenes.erase(it);
+			dirty = true;
 		}
-	} else if (canvas) {
-		obs_source_t *source = obs_canvas_get_channel(canvas, 0);
-		while (source && obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION) {
-			obs_source_t *ts = obs_transition_get_active_source(source);
-			if (ts) {
-				obs_source_release(source);
-				source = ts;
-			} else {
-				break;
-			}
-		}
-		if (source && obs_source_is_scene(source)) {
-			scene = source;
-		} else {
-			obs_source_release(source);
-		}
-	} else {
-		scene = obs_frontend_get_current_scene();
+		obs_source_release(source);
+		if (found)
+			break;
 	}
-	const auto sn = obs_source_get_name(scene);
-	if (strcmp(sn, scene_name) == 0)
-		SceneChanged(sn);
-	obs_source_release(scene);
+	ExcludeSceneChanged(scene_name);
 }
-bool DownstreamKeyer::IsSceneExcluded(const char *scene_name)
+
+bool DownstreamKeyer::IsSceneExcluded(obs_source_t *scene, bool include_rules)
 {
-	return exclude_scenes.find(scene_name) != exclude_scenes.end();
+	if (!scene)
+		return false;
+	auto it = exclude_sources.find(scene);
+	if (it != exclude_sources.end() && obs_weak_source_references_source(it->second, scene))
+		return true;
+	return include_rules && MatchesExcludeRules(scene);
 }
 
 QString DownstreamKeyer::GetScene()
@@ -908,6 +1490,11 @@ QString DownstreamKeyer::GetScene()
 	return "";
 }
 
+int DownstreamKeyer::GetSceneCount()
+{
+	return scenesList->count();
+}
+
 bool DownstreamKeyer::SwitchToScene(QString scene_name)
 {
 	if (scene_name.isEmpty()) {
@@ -928,6 +1515,209 @@ bool DownstreamKeyer::SwitchToScene(QString scene_name)
 	return false;
 }
 
+struct warm_collect {
+	std::set<obs_source_t *> onAir;
+	std::vector<obs_source_t *> children;
+};
+
+static void collect_on_air_source(obs_source_t *parent, obs_source_t *child, void *param)
+{
+	UNUSED_PARAMETER(parent);
+	static_cast<std::set<obs_source_t *> *>(param)->insert(child);
+}
+
+static void collect_warm_source(obs_source_t *parent, obs_source_t *child, void *param)
+{
+	UNUSED_PARAMETER(parent);
+	auto collect = static_cast<warm_collect *>(param);
+	if (collect->onAir.count(child))
+		return;
+	if (obs_source_is_scene(child) || obs_source_is_group(child) || obs_source_get_type(child) == OBS_SOURCE_TYPE_TRANSITION)
+		return;
+	collect->children.push_back(obs_source_get_ref(child));
+}
+
+void DownstreamKeyer::WarmTransition(obs_source_t *transition)
+{
+	if (!transition)
+		return;
+	for (const auto &warm : warmSources) {
+		if (warm.first == transition)
+			return;
+	}
+	// keep media of stingers and other source based transitions open so the first take does not decode from scratch
+	// the full tree also holds the A/B sources the transition currently shows, leave those scenes and their sources alone
+	warm_collect collect;
+	for (auto target : {OBS_TRANSITION_SOURCE_A, OBS_TRANSITION_SOURCE_B}) {
+		obs_source_t *source = obs_transition_get_source(transition, target);
+		if (!source)
+			continue;
+		collect.onAir.insert(source);
+		obs_source_enum_full_tree(source, collect_on_air_source, &collect.onAir);
+		obs_source_release(source);
+	}
+	obs_source_enum_full_tree(transition, collect_warm_source, &collect);
+	for (auto child : collect.children) {
+		if (!child)
+			continue;
+		obs_source_inc_showing(child);
+		warmSources.emplace_back(transition, child);
+	}
+	if (!collect.children.empty())
+		readyTimer.start();
+	RequestStatePublish();
+}
+
+void DownstreamKeyer::CoolTransition(obs_source_t *transition)
+{
+	for (auto it = warmSources.begin(); it != warmSources.end();) {
+		if (transition && it->first != transition) {
+			++it;
+			continue;
+		}
+		obs_source_dec_showing(it->second);
+		obs_source_release(it->second);
+		it = warmSources.erase(it);
+	}
+}
+
+void DownstreamKeyer::SetPreloadTransitions(bool preload)
+{
+	if (preload == preloadTransitions)
+		return;
+	preloadTransitions = preload;
+	dirty = true;
+	RequestStatePublish();
+	if (!preloadTransitions) {
+		CoolTransition(nullptr);
+		return;
+	}
+	Materialize();
+	WarmTransition(transition);
+	WarmTransition(showTransition);
+	WarmTransition(hideTransition);
+}
+
+bool DownstreamKeyer::GetPreloadTransitions()
+{
+	return preloadTransitions;
+}
+
+bool DownstreamKeyer::TransitionsReady()
+{
+	if (!preloadTransitions || transitionsPending)
+		return false;
+	for (const auto &warm : warmSources) {
+		// heuristic: async media reports a size once the first frame has been decoded
+		if ((obs_source_get_output_flags(warm.second) & OBS_SOURCE_ASYNC_VIDEO) == OBS_SOURCE_ASYNC_VIDEO &&
+		    !obs_source_get_width(warm.second))
+			return false;
+	}
+	return true;
+}
+
+uint32_t DownstreamKeyer::GetId()
+{
+	return id;
+}
+
+obs_data_t *DownstreamKeyer::GetState()
+{
+	obs_data_t *state = obs_data_create();
+	obs_data_set_string(state, "dsk_name", QT_TO_UTF8(objectName()));
+	obs_data_set_int(state, "dsk_id", id);
+	obs_data_set_int(state, "dsk_channel", outputChannel);
+	obs_data_set_string(state, "scene", QT_TO_UTF8(GetScene()));
+	obs_data_set_string(state, "cued_scene", QT_TO_UTF8(GetCuedScene()));
+	obs_data_set_bool(state, "tie", tie->isChecked());
+	obs_data_set_bool(state, "rendering", IsRendering());
+	obs_data_set_string(state, "transition", GetTransition().c_str());
+	obs_data_set_int(state, "transition_duration", transitionDuration);
+	obs_data_set_string(state, "show_transition", GetTransition(transitionType::show).c_str());
+	obs_data_set_int(state, "show_transition_duration", showTransitionDuration);
+	obs_data_set_string(state, "hide_transition", GetTransition(transitionType::hide).c_str());
+	obs_data_set_int(state, "hide_transition_duration", hideTransitionDuration);
+	obs_data_set_bool(state, "preload_transitions", preloadTransitions);
+	obs_data_set_bool(state, "transitions_ready", TransitionsReady());
+	obs_source_t *t = runningTransition;
+	const bool transitioning = t && (t == transition || t == showTransition || t == hideTransition || t == overrideTransition);
+	obs_data_set_string(state, "transition_phase", transitioning ? "transitioning" : "idle");
+	obs_data_set_double(state, "transition_progress", transitioning ? std::min(obs_transition_get_time(t), 1.0f) : 1.0);
+	uint32_t runningDuration = 0;
+	if (transitioning)
+		runningDuration = t == showTransition	    ? showTransitionDuration
+				  : t == hideTransition	    ? hideTransitionDuration
+				  : t == overrideTransition ? overrideTransitionDuration
+							    : transitionDuration;
+	obs_data_set_int(state, "transition_start_ns", transitioning ? (long long)transitionStartTime : 0);
+	obs_data_set_int(state, "running_transition_duration", runningDuration);
+	obs_data_set_int(state, "last_transition_duration", (long long)lastTransitionDuration);
+	return state;
+}
+
+bool DownstreamKeyer::CueScene(QString scene_name)
+{
+	if (scene_name.isEmpty()) {
+		ClearCue();
+		return true;
+	}
+	const auto items = scenesList->findItems(scene_name, Qt::MatchFixedString);
+	if (items.isEmpty())
+		return false;
+	obs_source_t *scene = canvas ? obs_canvas_get_source_by_name(canvas, QT_TO_UTF8(scene_name))
+				     : obs_get_source_by_name(QT_TO_UTF8(scene_name));
+	if (!scene)
+		return false;
+	obs_source_t *renderSource = GetRenderSource(scene);
+	obs_source_release(scene);
+	if (renderSource == cuedSource) {
+		obs_source_release(renderSource);
+		return true;
+	}
+	ClearCue();
+	// showing but not routed, media and browser sources warm up before the take
+	cuedSource = renderSource;
+	obs_source_inc_showing(cuedSource);
+	RequestStatePublish();
+	auto font = items.value(0)->font();
+	font.setItalic(true);
+	items.value(0)->setFont(font);
+	return true;
+}
+
+void DownstreamKeyer::ClearCue()
+{
+	if (!cuedSource)
+		return;
+	const auto name = QT_UTF8(obs_source_get_name(cuedSource));
+	for (auto item : scenesList->findItems(name, Qt::MatchFixedString)) {
+		auto font = item->font();
+		font.setItalic(false);
+		item->setFont(font);
+	}
+	obs_source_dec_showing(cuedSource);
+	obs_source_release(cuedSource);
+	cuedSource = nullptr;
+	RequestStatePublish();
+}
+
+QString DownstreamKeyer::GetCuedScene()
+{
+	return cuedSource ? QT_UTF8(obs_source_get_name(cuedSource)) : QString();
+}
+
+bool DownstreamKeyer::Take()
+{
+	if (!cuedSource)
+		return false;
+	if (!SwitchToScene(GetCuedScene()))
+		return false;
+	// a tied keyer only follows scene changes, a take goes to output right away
+	apply_selected_source();
+	ClearCue();
+	return true;
+}
+
 void DownstreamKeyer::add_scene(QString scene_name, obs_source_t *s, int insertBeforeRow)
 {
 	const auto item = new QListWidgetItem(scene_name);
@@ -937,18 +1727,7 @@ void DownstreamKeyer::add_scene(QString scene_name, obs_source_t *s, int insertB
 	}
 	scenesList->insertItem(insertBeforeRow, item);
 
-	std::string enable_hotkey = obs_module_text("EnableDSK");
-	enable_hotkey += " ";
-	enable_hotkey += QT_TO_UTF8(objectName());
-	std::string disable_hotkey = obs_module_text("DisableDSK");
-	disable_hotkey += " ";
-	disable_hotkey += QT_TO_UTF8(objectName());
-	uint64_t h = obs_hotkey_pair_register_source(s, enable_hotkey.c_str(), enable_hotkey.c_str(), disable_hotkey.c_str(),
-						     disable_hotkey.c_str(), enable_DSK_hotkey, disable_DSK_hotkey, this, this);
-
-	if (h != OBS_INVALID_HOTKEY_PAIR_ID) {
-		item->setData(Qt::UserRole, static_cast<uint>(h));
-	}
+	RegisterSceneHotkey(item, s);
 }
 
 bool DownstreamKeyer::AddScene(QString scene_name, int insertBeforeRow)
@@ -983,7 +1762,7 @@ bool DownstreamKeyer::RemoveScene(QString scene_name)
 
 		if (item->text() == scene_name) {
 			scenesList->removeItemWidget(item);
-			obs_hotkey_pair_unregister(item->data(Qt::UserRole).toUInt());
+			UnregisterSceneHotkey(item);
 			delete item;
 			return true;
 		}
@@ -991,6 +1770,74 @@ bool DownstreamKeyer::RemoveScene(QString scene_name)
 	return false;
 }
 
+void DownstreamKeyer::SetScenes(const QStringList &scene_names, QStringList &unresolved)
+{
+	QHash<QString, QListWidgetItem *> existing;
+	for (int i = 0; i < scenesList->count(); i++) {
+		auto item = scenesList->item(i);
+		if (item)
+			existing.insert(item->text(), item);
+	}
+
+	// resolve the new list first, only names not already in the list need a source lookup
+	std::vector<QListWidgetItem *> items;
+	std::vector<std::pair<QListWidgetItem *, obs_source_t *>> added;
+	QSet<QString> seen;
+	for (const auto &scene_name : scene_names) {
+		if (scene_name.isEmpty() || seen.contains(scene_name))
+			continue;
+		seen.insert(scene_name);
+		auto it = existing.find(scene_name);
+		if (it != existing.end()) {
+			items.push_back(it.value());
+			existing.erase(it);
+			continue;
+		}
+		auto nameUtf8 = scene_name.toUtf8();
+		auto name = nameUtf8.constData();
+		auto s = canvas ? obs_canvas_get_source_by_name(canvas, name) : obs_get_source_by_name(name);
+		if (!obs_source_is_scene(s)) {
+			obs_source_release(s);
+			unresolved.append(scene_name);
+			continue;
+		}
+		auto item = new QListWidgetItem(scene_name);
+		items.push_back(item);
+		added.emplace_back(item, s);
+	}
+
+	scenesList->setUpdatesEnabled(false);
+	for (auto item : existing) {
+		scenesList->removeItemWidget(item);
+		UnregisterSceneHotkey(item);
+		delete item;
+	}
+
+	QListWidgetItem *current = scenesList->currentItem();
+	scenesList->blockSignals(true);
+	for (int i = 0; i < (int)items.size(); i++) {
+		const int row = scenesList->row(items[i]);
+		if (row == i)
+			continue;
+		if (row >= 0)
+			scenesList->takeItem(row);
+		scenesList->insertItem(i, items[i]);
+	}
+	if (current) {
+		scenesList->setCurrentItem(current);
+		current->setSelected(true);
+	}
+	scenesList->blockSignals(false);
+	scenesList->setUpdatesEnabled(true);
+
+	for (auto &it : added) {
+		RegisterSceneHotkey(it.first, it.second);
+		obs_source_release(it.second);
+	}
+	dirty = true;
+	RequestStatePublish();
+}
+
 void DownstreamKeyer::SetTie(bool tie)
 {
 	this->tie->setChecked(tie);
@@ -1000,9 +1847,13 @@ void DownstreamKeyer::SetOutputChannel(int oc)
 {
 	if (oc == outputChannel)
 		return;
-	obs_source_t *prevSource = view     ? obs_view_get_source(view, outputChannel)
-				   : canvas ? obs_canvas_get_channel(canvas, outputChannel)
-					    : obs_get_output_source(outputChannel);
+	if (compositeSlot) {
+		// the channel is only reserved while the dock renders through its composite scene
+		outputChannel = oc;
+		dirty = true;
+		return;
+	}
+	obs_source_t *prevSource = GetChannelSource();
 	obs_source_t *prevTransition = nullptr;
 	if (prevSource && obs_source_get_type(prevSource) == OBS_SOURCE_TYPE_TRANSITION) {
 		prevTransition = prevSource;
@@ -1011,30 +1862,20 @@ void DownstreamKeyer::SetOutputChannel(int oc)
 	if (prevTransition) {
 		if (prevTransition == transition || prevTransition == showTransition || prevTransition == hideTransition ||
 		    prevTransition == overrideTransition) {
-			if (view) {
-				obs_view_set_source(view, outputChannel, nullptr);
-			} else if (canvas) {
-				obs_canvas_set_channel(canvas, outputChannel, nullptr);
-			} else {
-				obs_set_output_source(outputChannel, nullptr);
-			}
+			SetChannelSource(nullptr);
 		} else {
 			obs_source_release(prevTransition);
 			prevTransition = nullptr;
 		}
 	} else if (prevSource) {
 		const auto l = scenesList->selectedItems();
-		const auto newSource = l.count() ? (canvas ? obs_canvas_get_source_by_name(canvas, QT_TO_UTF8(l.value(0)->text()))
-							   : obs_get_source_by_name(QT_TO_UTF8(l.value(0)->text())))
-						 : nullptr;
+		const auto scene = l.count() ? (canvas ? obs_canvas_get_source_by_name(canvas, QT_TO_UTF8(l.value(0)->text()))
+						       : obs_get_source_by_name(QT_TO_UTF8(l.value(0)->text())))
+					     : nullptr;
+		const auto newSource = GetRenderSource(scene);
+		obs_source_release(scene);
 		if (prevSource == newSource) {
-			if (view) {
-				obs_view_set_source(view, outputChannel, nullptr);
-			} else if (canvas) {
-				obs_canvas_set_channel(canvas, outputChannel, nullptr);
-			} else {
-				obs_set_output_source(outputChannel, nullptr);
-			}
+			SetChannelSource(nullptr);
 			obs_source_release(newSource);
 		} else {
 			obs_source_release(prevSource);
@@ -1042,14 +1883,10 @@ void DownstreamKeyer::SetOutputChannel(int oc)
 		}
 	}
 	outputChannel = oc;
+	dirty = true;
+	RequestStatePublish();
 	if (prevTransition) {
-		if (view) {
-			obs_view_set_source(view, outputChannel, prevTransition);
-		} else if (canvas) {
-			obs_canvas_set_channel(canvas, outputChannel, prevTransition);
-		} else {
-			obs_set_output_source(outputChannel, prevTransition);
-		}
+		SetChannelSource(prevTransition);
 	} else {
 		apply_selected_source();
 	}
@@ -1057,6 +1894,280 @@ void DownstreamKeyer::SetOutputChannel(int oc)
 	obs_source_release(prevTransition);
 }
 
+// hotkeys carry the keyer name, they are renamed in place so their bindings stay
+void DownstreamKeyer::SetName(const QString &name)
+{
+	setObjectName(name);
+	const std::string disableDsk = std::string(obs_module_text("DisableDSK")) + " " + QT_TO_UTF8(name);
+	obs_hotkey_set_name(null_hotkey_id, disableDsk.c_str());
+	obs_hotkey_set_description(null_hotkey_id, disableDsk.c_str());
+	const std::string enableTie = std::string(obs_module_text("EnableTie")) + " " + QT_TO_UTF8(name);
+	const std::string disableTie = std::string(obs_module_text("DisableTie")) + " " + QT_TO_UTF8(name);
+	obs_hotkey_pair_set_names(tie_hotkey_id, enableTie.c_str(), disableTie.c_str());
+	obs_hotkey_pair_set_descriptions(tie_hotkey_id, enableTie.c_str(), disableTie.c_str());
+
+	// shared scene hotkeys do not carry a keyer name
+	const std::string enableDsk = std::string(obs_module_text("EnableDSK")) + " " + QT_TO_UTF8(name);
+	const int count = scenesList->count();
+	for (int i = 0; i < count; i++) {
+		const auto item = scenesList->item(i);
+		const auto data = item->data(Qt::UserRole);
+		if (!data.isValid() || item->data(Qt::UserRole + 1).toBool())
+			continue;
+		const obs_hotkey_pair_id h = data.toUInt();
+		obs_hotkey_pair_set_names(h, enableDsk.c_str(), disableDsk.c_str());
+		obs_hotkey_pair_set_descriptions(h, enableDsk.c_str(), disableDsk.c_str());
+	}
+	dirty = true;
+	RequestStatePublish();
+}
+
+// exchanges channels with the sources currently on them, a running transition keeps going on its new channel
+void DownstreamKeyer::SwapOutputChannel(DownstreamKeyer *other)
+{
+	if (!other || other == this)
+		return;
+	obs_source_t *source = GetChannelSource();
+	obs_source_t *otherSource = other->GetChannelSource();
+	std::swap(outputChannel, other->outputChannel);
+	SetChannelSource(source);
+	other->SetChannelSource(otherSource);
+	obs_source_release(source);
+	obs_source_release(otherSource);
+	dirty = true;
+	other->dirty = true;
+	RequestStatePublish();
+}
+
+int DownstreamKeyer::GetOutputChannel()
+{
+	return outputChannel;
+}
+
+void DownstreamKeyer::ConnectTransitionSignals(obs_source_t *t)
+{
+	auto sh = obs_source_get_signal_handler(t);
+	signal_handler_connect(sh, "transition_start", transition_start, this);
+	signal_handler_connect(sh, "transition_stop", transition_stop, this);
+}
+
+void DownstreamKeyer::DisconnectTransitionSignals(obs_source_t *t)
+{
+	auto sh = obs_source_get_signal_handler(t);
+	signal_handler_disconnect(sh, "transition_start", transition_start, this);
+	signal_handler_disconnect(sh, "transition_stop", transition_stop, this);
+	runningTransition.compare_exchange_strong(t, nullptr);
+}
+
+void DownstreamKeyer::transition_start(void *data, calldata_t *calldata)
+{
+	const auto downstreamKeyer = static_cast<DownstreamKeyer *>(data);
+	// timestamps are taken on the signal, queued UI work would add its own latency to the measurement
+	downstreamKeyer->transitionStartTime = os_gettime_ns();
+	downstreamKeyer->runningTransition = static_cast<obs_source_t *>(calldata_ptr(calldata, "source"));
+	QMetaObject::invokeMethod(downstreamKeyer, "TransitionStarted", Qt::QueuedConnection);
+}
+
+void DownstreamKeyer::transition_stop(void *data, calldata_t *calldata)
+{
+	const auto downstreamKeyer = static_cast<DownstreamKeyer *>(data);
+	obs_source_t *t = static_cast<obs_source_t *>(calldata_ptr(calldata, "source"));
+	const uint64_t start = downstreamKeyer->transitionStartTime;
+	downstreamKeyer->lastTransitionDuration = start ? (os_gettime_ns() - start) / 1000000 : 0;
+	downstreamKeyer->runningTransition.compare_exchange_strong(t, nullptr);
+	QMetaObject::invokeMethod(downstreamKeyer, "TransitionStopped", Qt::QueuedConnection);
+}
+
+void DownstreamKeyer::TransitionStarted()
+{
+	obs_source_t *t = runningTransition;
+	if (t != transition && t != showTransition && t != hideTransition && t != overrideTransition)
+		return;
+	RequestStatePublish();
+	if (!vendor)
+		return;
+	obs_source_t *target = obs_transition_get_source(t, OBS_TRANSITION_SOURCE_B);
+	const auto data = obs_data_create();
+	obs_data_set_string(data, "dsk_name", QT_TO_UTF8(objectName()));
+	obs_data_set_int(data, "dsk_channel", outputChannel);
+	obs_data_set_string(data, "view_name", viewName.c_str());
+	obs_data_set_string(data, "transition", obs_source_get_name(t));
+	obs_data_set_string(data, "scene", target ? obs_source_get_name(target) : "");
+	AddEventSubscribers(data, "dsk_transition_started", viewName, QT_TO_UTF8(objectName()));
+	obs_websocket_vendor_emit_event(vendor, "dsk_transition_started", data);
+	obs_data_release(data);
+	obs_source_release(target);
+}
+
+void DownstreamKeyer::TransitionStopped()
+{
+	RequestStatePublish();
+	if (vendor) {
+		obs_source_t *source = GetChannelSource();
+		obs_source_t *active = source && obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION
+					       ? obs_transition_get_active_source(source)
+					       : obs_source_get_ref(source);
+		const auto data = obs_data_create();
+		obs_data_set_string(data, "dsk_name", QT_TO_UTF8(objectName()));
+		obs_data_set_int(data, "dsk_channel", outputChannel);
+		obs_data_set_string(data, "transition",
+				    source && obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION ? obs_source_get_name(source)
+													 : "");
+		obs_data_set_string(data, "scene", active ? obs_source_get_name(active) : "");
+		obs_data_set_int(data, "duration", (long long)lastTransitionDuration);
+		obs_data_set_string(data, "view_name", viewName.c_str());
+		AddEventSubscribers(data, "dsk_transition_ended", viewName, QT_TO_UTF8(objectName()));
+		obs_websocket_vendor_emit_event(vendor, "dsk_transition_ended", data);
+		obs_data_release(data);
+		obs_source_release(active);
+		obs_source_release(source);
+	}
+	UnbindIdleTransition();
+}
+
+void DownstreamKeyer::UnbindIdleTransition()
+{
+	// a finished hide transition keeps rendering an empty frame every tick until the next take
+	obs_source_t *source = GetChannelSource();
+	if (!source)
+		return;
+	if (obs_source_get_type(source) == OBS_SOURCE_TYPE_TRANSITION &&
+	    (source == transition || source == showTransition || source == hideTransition || source == overrideTransition)) {
+		obs_source_t *active = obs_transition_get_active_source(source);
+		if (!active)
+			SetChannelSource(nullptr);
+		obs_source_release(active);
+	}
+	obs_source_release(source);
+}
+
+bool DownstreamKeyer::IsRendering()
+{
+	obs_source_t *source = GetChannelSource();
+	obs_source_release(source);
+	return source != nullptr;
+}
+
+obs_source_t *DownstreamKeyer::GetRenderSource(obs_source_t *scene)
+{
+	if (!scene)
+		return nullptr;
+	const auto items = scenesList->findItems(QT_UTF8(obs_source_get_name(scene)), Qt::MatchFixedString);
+	if (items.isEmpty() || !items.value(0)->data(Qt::UserRole + 2).toBool())
+		return obs_source_get_ref(scene);
+	const std::string uuid = obs_source_get_uuid(scene);
+	auto it = staticCaches.find(uuid);
+	if (it == staticCaches.end()) {
+		obs_data_t *settings = obs_data_create();
+		obs_data_set_string(settings, "source", uuid.c_str());
+		// named after the scene so transition tables and vendor events see the scene name
+		obs_source_t *cache = obs_source_create_private("dsk_static_cache", obs_source_get_name(scene), settings);
+		obs_data_release(settings);
+		if (!cache)
+			return obs_source_get_ref(scene);
+		it = staticCaches.emplace(uuid, cache).first;
+	}
+	return obs_source_get_ref(it->second);
+}
+
+void DownstreamKeyer::ReleaseStaticCache(obs_source_t *scene)
+{
+	const char *uuid = obs_source_get_uuid(scene);
+	if (!uuid)
+		return;
+	auto it = staticCaches.find(uuid);
+	if (it == staticCaches.end())
+		return;
+	obs_source_release(it->second);
+	staticCaches.erase(it);
+}
+
+void DownstreamKeyer::scenesList_contextMenu(const QPoint &pos)
+{
+	auto item = scenesList->itemAt(pos);
+	if (!item)
+		return;
+	QMenu popup;
+	auto a = popup.addAction(QT_UTF8(obs_module_text("StaticScene")));
+	a->setCheckable(true);
+	a->setChecked(item->data(Qt::UserRole + 2).toBool());
+	connect(a, &QAction::triggered, [this, item](bool checked) {
+		item->setData(Qt::UserRole + 2, checked);
+		dirty = true;
+		obs_source_t *scene = canvas ? obs_canvas_get_source_by_name(canvas, QT_TO_UTF8(item->text()))
+					     : obs_get_source_by_name(QT_TO_UTF8(item->text()));
+		if (!scene)
+			return;
+		if (item->isSelected()) {
+			obs_source_t *current = GetChannelSource();
+			if (current && obs_source_get_type(current) == OBS_SOURCE_TYPE_TRANSITION) {
+				obs_source_t *transition = current;
+				current = obs_transition_get_active_source(transition);
+				obs_source_release(transition);
+			}
+			// swap the live output between the scene and its cache without a visible transition
+			if (current && strcmp(obs_source_get_name(current), obs_source_get_name(scene)) == 0) {
+				obs_source_t *renderSource = GetRenderSource(scene);
+				SetChannelSource(renderSource);
+				obs_source_release(renderSource);
+			}
+			obs_source_release(current);
+		}
+		// the cached texture is only needed while the scene is static
+		if (!checked)
+			ReleaseStaticCache(scene);
+		obs_source_release(scene);
+	});
+	popup.addSeparator();
+	a = popup.addAction(QT_UTF8(obs_module_text("CueScene")));
+	a->setCheckable(true);
+	a->setChecked(GetCuedScene() == item->text());
+	connect(a, &QAction::triggered, [this, item](bool checked) { CueScene(checked ? item->text() : QString()); });
+	a = popup.addAction(QT_UTF8(obs_module_text("Take")));
+	a->setEnabled(cuedSource != nullptr);
+	connect(a, &QAction::triggered, [this] { Take(); });
+	popup.exec(scenesList->mapToGlobal(pos));
+}
+
+obs_source_t *DownstreamKeyer::GetChannelSource()
+{
+	if (compositeSlot)
+		return obs_transition_get_active_source(compositeSlot);
+	return view ? obs_view_get_source(view, outputChannel)
+	       : canvas ? obs_canvas_get_channel(canvas, outputChannel)
+			: obs_get_output_source(outputChannel);
+}
+
+void DownstreamKeyer::SetChannelSource(obs_source_t *source)
+{
+	if (compositeSlot) {
+		obs_transition_set(compositeSlot, source);
+	} else if (view) {
+		obs_view_set_source(view, outputChannel, source);
+	} else if (canvas) {
+		obs_canvas_set_channel(canvas, outputChannel, source);
+	} else {
+		obs_set_output_source(outputChannel, source);
+	}
+}
+
+void DownstreamKeyer::SetCompositeSlot(obs_source_t *slot)
+{
+	if (slot == compositeSlot)
+		return;
+	obs_source_t *current = GetChannelSource();
+	SetChannelSource(nullptr);
+	obs_source_release(compositeSlot);
+	compositeSlot = obs_source_get_ref(slot);
+	SetChannelSource(current);
+	obs_source_release(current);
+}
+
+obs_source_t *DownstreamKeyer::GetCompositeSlot()
+{
+	return compositeSlot;
+}
+
 LockedCheckBox::LockedCheckBox()
 {
 	setProperty("lockCheckBox", true);
@@ -4,17 +4,41 @@
 #include <QComboBox>
 #include <QLabel>
 #include <QListWidget>
+#include <QRegularExpression>
 #include <QSpinBox>
 #include <QTimer>
 #include <QToolBar>
 #include <QWidget>
+#include <atomic>
+#include <map>
+#include <mutex>
 #include <set>
+#include <unordered_map>
+#include <vector>
 
 #include "obs.h"
 #include "obs-websocket-api.h"
 
 typedef void (*get_transitions_callback_t)(void *data, struct obs_frontend_source_list *sources);
 
+// Active scene on channel 0 of a view, canvas or the main output, cached until the next scene change
+obs_source_t *GetActiveScene(obs_view_t *view, obs_canvas_t *canvas);
+void InvalidateActiveScene(void *view_or_canvas);
+void InvalidateActiveScenes();
+void ClearActiveScenes();
+
+// Vendor event subscriptions. Events are always broadcast, subscriptions only mark which subscribers an event is for,
+// so clients that never subscribed keep receiving everything. A subscription expires unless subscribe is repeated.
+void SubscribeEvents(const char *subscriber, const char *view_name, const char *dsk_name, const std::vector<std::string> &events,
+		     int ttl_seconds);
+bool UnsubscribeEvents(const char *subscriber);
+void AddEventSubscribers(obs_data_t *data, const char *event, const std::string &view_name, const char *dsk_name);
+void SetEventCoalescing(int window_ms);
+int GetEventCoalescing();
+
+// Queue a refresh of the shared memory state export, repeated requests before it runs are merged
+void RequestStatePublish();
+
 class LockedCheckBox : public QCheckBox {
 	Q_OBJECT
 
@@ -30,6 +54,13 @@ class DownstreamKeyer : public QWidget {
 
 private:
 	QTimer hideTimer;
+	QTimer sceneEventTimer;
+	QTimer readyTimer;
+	std::string pendingOldScene;
+	std::string pendingNewScene;
+	int coalescedSceneEvents = 0;
+	std::string viewName;
+	uint32_t id;
 	int outputChannel;
 	obs_source_t *transition;
 	obs_source_t *showTransition;
@@ -45,23 +76,78 @@ private:
 	LockedCheckBox *tie;
 	obs_hotkey_id null_hotkey_id;
 	obs_hotkey_pair_id tie_hotkey_id;
-	std::set<std::string> exclude_scenes;
+	struct excluded_scene {
+		std::string uuid;
+		std::string name;
+		obs_weak_source_t *source;
+	};
+	std::vector<excluded_scene> exclude_scenes;
+	std::unordered_map<obs_source_t *, obs_weak_source_t *> exclude_sources;
+	std::vector<std::pair<std::string, std::string>> exclude_rules;
+	std::vector<QRegularExpression> exclude_rules_matchers;
+	std::unordered_map<obs_source_t *, bool> exclude_rules_cache;
 	obs_view_t *view = nullptr;
 	obs_canvas_t *canvas = nullptr;
 	get_transitions_callback_t get_transitions = nullptr;
 	void *get_transitions_data = nullptr;
+	bool dirty = true;
+	obs_data_t *saveData = nullptr;
+	std::string pendingTransitions[3];
+	bool transitionsPending = false;
+	obs_source_t *compositeSlot = nullptr;
+	std::map<std::string, obs_source_t *> staticCaches;
+	obs_source_t *cuedSource = nullptr;
+	bool preloadTransitions = false;
+	std::vector<std::pair<obs_source_t *, obs_source_t *>> warmSources;
+	std::atomic<obs_source_t *> runningTransition = nullptr;
+	std::atomic<uint64_t> transitionStartTime = 0;
+	std::atomic<uint64_t> lastTransitionDuration = 0;
 
 	static void source_rename(void *data, calldata_t *calldata);
 	static void source_remove(void *data, calldata_t *calldata);
+	static void hotkey_bindings_changed(void *data, calldata_t *calldata);
+	static void transition_start(void *data, calldata_t *calldata);
+	static void transition_stop(void *data, calldata_t *calldata);
 	static bool enable_DSK_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
 	static bool disable_DSK_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
 
+	static bool enable_shared_DSK_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
+	static bool disable_shared_DSK_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
+
 	static void null_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed);
 
 	static bool enable_tie_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
 	static bool disable_tie_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
 
+	struct SceneHotkeyRoute {
+		obs_hotkey_pair_id id;
+		std::vector<DownstreamKeyer *> keyers;
+	};
+	static bool sharedSceneHotkeys;
+	static std::map<obs_source_t *, SceneHotkeyRoute> sceneHotkeyRoutes;
+	static std::mutex sceneHotkeyRoutesMutex;
+
+	void RegisterSceneHotkey(QListWidgetItem *item, obs_source_t *source, obs_data_array_t *enable_bindings = nullptr,
+				 obs_data_array_t *disable_bindings = nullptr);
+	void UnregisterSceneHotkey(QListWidgetItem *item);
+	void AddExcludeSource(const char *uuid, const char *name);
+	void ClearExcludeScenes();
+	void ExcludeSceneChanged(const char *scene_name);
+	void CompileExcludeRules();
+	bool MatchesExcludeRules(obs_source_t *scene);
+
 	void ChangeSceneIndex(bool relative, int idx, int invalidIdx);
+	void EmitSceneChanged(obs_source_t *prevSource, obs_source_t *newSource);
+	void EmitSceneChangedEvent(const char *old_scene, const char *new_scene, int coalesced);
+	void SetPendingTransition(const char *transition_name, enum transitionType transition_type);
+	void ConnectTransitionSignals(obs_source_t *t);
+	void DisconnectTransitionSignals(obs_source_t *t);
+	void WarmTransition(obs_source_t *transition);
+	void CoolTransition(obs_source_t *transition);
+	obs_source_t *GetRenderSource(obs_source_t *scene);
+	void ReleaseStaticCache(obs_source_t *scene);
+	obs_source_t *GetChannelSource();
+	void SetChannelSource(obs_source_t *source);
 
 private slots:
 	void on_actionAddScene_triggered();
@@ -69,9 +155,13 @@ private slots:
 	void on_actionSceneUp_triggered();
 	void on_actionSceneDown_triggered();
 	void on_actionSceneNull_triggered();
-	void apply_source(obs_source_t *newSource);
+	void apply_source(obs_source_t *scene);
+	void scenesList_contextMenu(const QPoint &pos);
 	void apply_selected_source();
 	void on_scenesList_itemSelectionChanged();
+	void TransitionStarted();
+	void TransitionStopped();
+	void UnbindIdleTransition();
 signals:
 
 public:
@@ -81,21 +171,48 @@ public:
 
 	void Save(obs_data_t *data);
 	void Load(obs_data_t *data);
+	obs_data_t *GetSaveData(const char *name);
 	void SetTransition(const char *transition_name, enum transitionType transition_type = match);
 	std::string GetTransition(enum transitionType transition_type = match);
 	void SetTransitionDuration(int duration, enum transitionType transition_type = match);
 	int GetTransitionDuration(enum transitionType transition_type = match);
 	void SetHideAfter(int duration);
 	int GetHideAfter();
-	void SceneChanged(std::string scene);
+	void SceneChanged(obs_source_t *scene);
 	void AddExcludeScene(const char *scene_name);
 	void RemoveExcludeScene(const char *scene_name);
-	bool IsSceneExcluded(const char *scene_name);
+	bool IsSceneExcluded(obs_source_t *scene, bool include_rules = true);
+	bool AddExcludeRule(const char *type, const char *pattern);
+	bool RemoveExcludeRule(const char *type, const char *pattern);
+	std::vector<std::pair<std::string, std::string>> GetExcludeRules();
 	QString GetScene();
+	int GetSceneCount();
 	bool SwitchToScene(QString scene_name);
+	bool CueScene(QString scene_name);
+	void ClearCue();
+	QString GetCuedScene();
+	bool Take();
+	void SetPreloadTransitions(bool preload);
+	bool GetPreloadTransitions();
+	bool TransitionsReady();
+	obs_data_t *GetState();
+	uint32_t GetId();
 	void add_scene(QString scene_name, obs_source_t *s, int insertBeforeRow);
 	bool AddScene(QString scene_name, int insertBeforeRow);
 	bool RemoveScene(QString scene_name);
+	void SetScenes(const QStringList &scene_names, QStringList &unresolved);
 	void SetTie(bool tie);
+	void SetViewName(const char *view_name);
 	void SetOutputChannel(int outputChannel);
+	void SwapOutputChannel(DownstreamKeyer *other);
+	void SetName(const QString &name);
+	int GetOutputChannel();
+	bool IsRendering();
+	void SetCompositeSlot(obs_source_t *slot);
+	obs_source_t *GetCompositeSlot();
+	void SetTransitions(get_transitions_callback_t get_transitions, void *get_transitions_data);
+	void Materialize();
+
+	static void SetSharedSceneHotkeys(bool shared, const std::vector<DownstreamKeyer *> &keyers);
+	static bool GetSharedSceneHotkeys();
 };
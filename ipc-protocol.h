@@ -0,0 +1,132 @@
+#pragma once
+/*
+ * Local control protocol for the downstream keyer.
+ *
+ * Every message is a frame of a little endian uint32 payload length followed by the payload.
+ * A request payload starts with a uint8 opcode, a response payload with a uint8 status.
+ * Strings are a little endian uint16 length followed by that many UTF-8 bytes without terminator.
+ *
+ * SELECT_SCENE    view, dsk, scene
+ * SET_TIE         view, dsk, u8 tie
+ * SET_TRANSITION  view, dsk, transition, u32 duration, u8 type (0 match, 1 show, 2 hide)
+ * GET_STATE       view, dsk
+ *                 -> scene, cued_scene, u32 channel, u8 tie, u8 rendering, phase, u16 progress (1/1000), u8 ready
+ * CUE_SCENE       view, dsk, scene
+ * TAKE            view, dsk
+ * BATCH           u16 count, count times (u32 length, request payload)
+ *                 -> u16 count, count times (u32 length, response payload)
+ *                 The response count can be lower than the request count when the responses do not fit in one
+ *                 frame, the requests after the last response did not run.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DSK_IPC_SOCKET_NAME "obs-downstream-keyer.sock"
+#define DSK_IPC_MAX_FRAME 65536
+
+enum dsk_ipc_op {
+	DSK_IPC_SELECT_SCENE = 1,
+	DSK_IPC_SET_TIE = 2,
+	DSK_IPC_SET_TRANSITION = 3,
+	DSK_IPC_GET_STATE = 4,
+	DSK_IPC_CUE_SCENE = 5,
+	DSK_IPC_TAKE = 6,
+	DSK_IPC_BATCH = 7,
+};
+
+enum dsk_ipc_status {
+	DSK_IPC_OK = 0,
+	DSK_IPC_FAILED = 1,
+	DSK_IPC_BAD_REQUEST = 2,
+};
+
+struct dsk_ipc_buffer {
+	uint8_t *data;
+	size_t size;
+	size_t pos;
+};
+
+static inline void dsk_ipc_socket_path(char *path, size_t size)
+{
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	if (!dir || !*dir)
+		dir = "/tmp";
+	snprintf(path, size, "%s/%s", dir, DSK_IPC_SOCKET_NAME);
+}
+
+static inline bool dsk_ipc_put(struct dsk_ipc_buffer *buf, const void *data, size_t size)
+{
+	if (buf->pos + size > buf->size)
+		return false;
+	memcpy(buf->data + buf->pos, data, size);
+	buf->pos += size;
+	return true;
+}
+
+static inline bool dsk_ipc_put_u8(struct dsk_ipc_buffer *buf, uint8_t val)
+{
+	return dsk_ipc_put(buf, &val, 1);
+}
+
+static inline bool dsk_ipc_put_u16(struct dsk_ipc_buffer *buf, uint16_t val)
+{
+	uint8_t b[2] = {(uint8_t)val, (uint8_t)(val >> 8)};
+	return dsk_ipc_put(buf, b, 2);
+}
+
+static inline bool dsk_ipc_put_u32(struct dsk_ipc_buffer *buf, uint32_t val)
+{
+	uint8_t b[4] = {(uint8_t)val, (uint8_t)(val >> 8), (uint8_t)(val >> 16), (uint8_t)(val >> 24)};
+	return dsk_ipc_put(buf, b, 4);
+}
+
+static inline bool dsk_ipc_put_str(struct dsk_ipc_buffer *buf, const char *str)
+{
+	size_t len = str ? strlen(str) : 0;
+	if (len > UINT16_MAX)
+		return false;
+	return dsk_ipc_put_u16(buf, (uint16_t)len) && dsk_ipc_put(buf, str, len);
+}
+
+static inline bool dsk_ipc_get_u8(struct dsk_ipc_buffer *buf, uint8_t *val)
+{
+	if (buf->pos + 1 > buf->size)
+		return false;
+	*val = buf->data[buf->pos++];
+	return true;
+}
+
+static inline bool dsk_ipc_get_u16(struct dsk_ipc_buffer *buf, uint16_t *val)
+{
+	if (buf->pos + 2 > buf->size)
+		return false;
+	*val = (uint16_t)(buf->data[buf->pos] | (buf->data[buf->pos + 1] << 8));
+	buf->pos += 2;
+	return true;
+}
+
+static inline bool dsk_ipc_get_u32(struct dsk_ipc_buffer *buf, uint32_t *val)
+{
+	if (buf->pos + 4 > buf->size)
+		return false;
+	*val = (uint32_t)buf->data[buf->pos] | ((uint32_t)buf->data[buf->pos + 1] << 8) |
+	       ((uint32_t)buf->data[buf->pos + 2] << 16) | ((uint32_t)buf->data[buf->pos + 3] << 24);
+	buf->pos += 4;
+	return true;
+}
+
+/* copies the string into out, always terminated, longer strings are rejected */
+static inline bool dsk_ipc_get_str(struct dsk_ipc_buffer *buf, char *out, size_t out_size)
+{
+	uint16_t len;
+	if (!dsk_ipc_get_u16(buf, &len) || buf->pos + len > buf->size || (size_t)len + 1 > out_size)
+		return false;
+	memcpy(out, buf->data + buf->pos, len);
+	out[len] = 0;
+	buf->pos += len;
+	return true;
+}
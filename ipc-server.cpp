@@ -0,0 +1,398 @@
+#include "ipc-server.hpp"
+#include <obs-module.h>
+
+#ifndef _WIN32
+#include "ipc-protocol.h"
+#include <QCoreApplication>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// a client is not read from while this many of its requests wait for the UI thread or this much output is unsent
+#define IPC_MAX_PENDING 64
+#define IPC_MAX_UNSENT (4 * DSK_IPC_MAX_FRAME)
+
+struct ipc_client {
+	uint64_t id;
+	int fd;
+	std::vector<uint8_t> in;
+	std::vector<uint8_t> out;
+	size_t pending;
+};
+
+static std::thread io_thread;
+static std::atomic<bool> running = false;
+static int listen_fd = -1;
+static int wake_fds[2] = {-1, -1};
+static char socket_path[sizeof(sockaddr_un::sun_path)];
+static uint64_t next_client_id = 1;
+
+// response frames served on the UI thread, picked up by the I/O thread
+static std::mutex responses_mutex;
+static std::vector<std::pair<uint64_t, std::vector<uint8_t>>> responses;
+
+static bool call_proc(const char *name, calldata_t *cd)
+{
+	return proc_handler_call(obs_get_proc_handler(), name, cd) && calldata_bool(cd, "success");
+}
+
+static const char *transition_type_name(uint8_t type)
+{
+	return type == 1 ? "show" : type == 2 ? "hide" : "match";
+}
+
+// returns false when the response did not fit, res is then left as it was
+static bool handle_request(struct dsk_ipc_buffer *req, struct dsk_ipc_buffer *res, bool nested)
+{
+	uint8_t op = 0;
+	char view[256];
+	char dsk[256];
+	char arg[512];
+	if (!dsk_ipc_get_u8(req, &op))
+		return dsk_ipc_put_u8(res, DSK_IPC_BAD_REQUEST);
+	if (op == DSK_IPC_BATCH) {
+		uint16_t count = 0;
+		if (nested || !dsk_ipc_get_u16(req, &count))
+			return dsk_ipc_put_u8(res, DSK_IPC_BAD_REQUEST);
+		// every request needs at least its length
+		if (count > (req->size - req->pos) / 4)
+			count = (uint16_t)((req->size - req->pos) / 4);
+		if (!dsk_ipc_put_u8(res, DSK_IPC_OK))
+			return false;
+		const size_t count_pos = res->pos;
+		if (!dsk_ipc_put_u16(res, 0))
+			return false;
+		// stops before a request whose response may not fit, the count tells the client how many ran
+		uint16_t answered = 0;
+		for (; answered < count; answered++) {
+			uint32_t len = 0;
+			if (!dsk_ipc_get_u32(req, &len) || req->pos + len > req->size)
+				len = 0;
+			if (res->size - res->pos < 5)
+				break;
+			struct dsk_ipc_buffer sub = {req->data + req->pos, len, 0};
+			req->pos += len;
+			const size_t len_pos = res->pos;
+			dsk_ipc_put_u32(res, 0);
+			if (!handle_request(&sub, res, true)) {
+				res->pos = len_pos;
+				break;
+			}
+			const uint32_t written = (uint32_t)(res->pos - len_pos - 4);
+			struct dsk_ipc_buffer patch = {res->data + len_pos, 4, 0};
+			dsk_ipc_put_u32(&patch, written);
+		}
+		struct dsk_ipc_buffer patch = {res->data + count_pos, 2, 0};
+		dsk_ipc_put_u16(&patch, answered);
+		return true;
+	}
+	if (!dsk_ipc_get_str(req, view, sizeof(view)) || !dsk_ipc_get_str(req, dsk, sizeof(dsk)))
+		return dsk_ipc_put_u8(res, DSK_IPC_BAD_REQUEST);
+
+	calldata_t cd = {0};
+	calldata_set_string(&cd, "view_name", view);
+	calldata_set_string(&cd, "dsk_name", dsk);
+	bool valid = true;
+	bool success = false;
+	if (op == DSK_IPC_SELECT_SCENE || op == DSK_IPC_CUE_SCENE) {
+		valid = dsk_ipc_get_str(req, arg, sizeof(arg));
+		if (valid) {
+			calldata_set_string(&cd, "scene", arg);
+			success = call_proc(op == DSK_IPC_SELECT_SCENE ? "downstream_keyer_select_scene" : "downstream_keyer_cue_scene",
+					    &cd);
+		}
+	} else if (op == DSK_IPC_SET_TIE) {
+		uint8_t tie = 0;
+		valid = dsk_ipc_get_u8(req, &tie);
+		if (valid) {
+			calldata_set_bool(&cd, "tie", tie != 0);
+			success = call_proc("downstream_keyer_set_tie", &cd);
+		}
+	} else if (op == DSK_IPC_SET_TRANSITION) {
+		uint32_t duration = 0;
+		uint8_t type = 0;
+		valid = dsk_ipc_get_str(req, arg, sizeof(arg)) && dsk_ipc_get_u32(req, &duration) && dsk_ipc_get_u8(req, &type);
+		if (valid) {
+			calldata_set_string(&cd, "transition", arg);
+			calldata_set_int(&cd, "duration", duration);
+			calldata_set_string(&cd, "transition_type", transition_type_name(type));
+			success = call_proc("downstream_keyer_set_transition", &cd);
+		}
+	} else if (op == DSK_IPC_TAKE) {
+		success = call_proc("downstream_keyer_take", &cd);
+	} else if (op == DSK_IPC_GET_STATE) {
+		success = call_proc("downstream_keyer_get_state", &cd);
+		if (success) {
+			double progress = calldata_float(&cd, "transition_progress");
+			const size_t start = res->pos;
+			const bool fit = dsk_ipc_put_u8(res, DSK_IPC_OK) && dsk_ipc_put_str(res, calldata_string(&cd, "scene")) &&
+					 dsk_ipc_put_str(res, calldata_string(&cd, "cued_scene")) &&
+					 dsk_ipc_put_u32(res, (uint32_t)calldata_int(&cd, "channel")) &&
+					 dsk_ipc_put_u8(res, calldata_bool(&cd, "tie")) &&
+					 dsk_ipc_put_u8(res, calldata_bool(&cd, "rendering")) &&
+					 dsk_ipc_put_str(res, calldata_string(&cd, "transition_phase")) &&
+					 dsk_ipc_put_u16(res, (uint16_t)(progress * 1000.0)) &&
+					 dsk_ipc_put_u8(res, calldata_bool(&cd, "transitions_ready"));
+			calldata_free(&cd);
+			if (!fit)
+				res->pos = start;
+			return fit;
+		}
+	} else {
+		valid = false;
+	}
+	calldata_free(&cd);
+	return dsk_ipc_put_u8(res, !valid ? DSK_IPC_BAD_REQUEST : success ? DSK_IPC_OK : DSK_IPC_FAILED);
+}
+
+// runs on the UI thread, which owns the keyers, so the procs do not have to wait for it
+static void serve_request(uint64_t client_id, const std::vector<uint8_t> &request)
+{
+	if (!running)
+		return;
+	static uint8_t out[DSK_IPC_MAX_FRAME];
+	struct dsk_ipc_buffer req = {(uint8_t *)request.data(), request.size(), 0};
+	struct dsk_ipc_buffer res = {out + 4, sizeof(out) - 4, 0};
+	if (!handle_request(&req, &res, false)) {
+		res.pos = 0;
+		dsk_ipc_put_u8(&res, DSK_IPC_FAILED);
+	}
+	struct dsk_ipc_buffer prefix = {out, 4, 0};
+	dsk_ipc_put_u32(&prefix, (uint32_t)res.pos);
+	{
+		std::lock_guard<std::mutex> lock(responses_mutex);
+		responses.emplace_back(client_id, std::vector<uint8_t>(out, out + res.pos + 4));
+	}
+	const char wake = 0;
+	if (write(wake_fds[1], &wake, 1) < 0 && errno != EAGAIN)
+		blog(LOG_WARNING, "[Downstream Keyer] local control wake failed: %d", errno);
+}
+
+// sends what the socket takes without blocking, a slow client keeps the rest queued
+static bool flush_client(ipc_client &client)
+{
+	size_t sent_total = 0;
+	while (sent_total < client.out.size()) {
+		ssize_t sent = send(client.fd, client.out.data() + sent_total, client.out.size() - sent_total, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR)
+			continue;
+		if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (sent <= 0)
+			return false;
+		sent_total += (size_t)sent;
+	}
+	client.out.erase(client.out.begin(), client.out.begin() + (long)sent_total);
+	return true;
+}
+
+static bool read_client(ipc_client &client)
+{
+	uint8_t tmp[4096];
+	ssize_t received = recv(client.fd, tmp, sizeof(tmp), 0);
+	if (received < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+		return true;
+	if (received <= 0)
+		return false;
+	client.in.insert(client.in.end(), tmp, tmp + received);
+
+	size_t consumed = 0;
+	while (client.in.size() - consumed >= 4) {
+		struct dsk_ipc_buffer header = {client.in.data() + consumed, 4, 0};
+		uint32_t len = 0;
+		dsk_ipc_get_u32(&header, &len);
+		if (len > DSK_IPC_MAX_FRAME)
+			return false;
+		if (client.in.size() - consumed < 4 + (size_t)len)
+			break;
+		std::vector<uint8_t> request(client.in.begin() + (long)consumed + 4, client.in.begin() + (long)(consumed + 4 + len));
+		const uint64_t id = client.id;
+		QMetaObject::invokeMethod(
+			QCoreApplication::instance(), [id, request]() { serve_request(id, request); }, Qt::QueuedConnection);
+		client.pending++;
+		consumed += 4 + (size_t)len;
+	}
+	client.in.erase(client.in.begin(), client.in.begin() + (long)consumed);
+	return true;
+}
+
+static void collect_responses(std::vector<ipc_client> &clients)
+{
+	std::vector<std::pair<uint64_t, std::vector<uint8_t>>> ready;
+	{
+		std::lock_guard<std::mutex> lock(responses_mutex);
+		ready.swap(responses);
+	}
+	for (auto &response : ready) {
+		// responses of clients that disconnected are dropped
+		auto it = std::find_if(clients.begin(), clients.end(), [&response](const ipc_client &c) { return c.id == response.first; });
+		if (it == clients.end())
+			continue;
+		it->out.insert(it->out.end(), response.second.begin(), response.second.end());
+		it->pending--;
+	}
+}
+
+// never waits on the UI thread, requests are handed to it and their responses come back through the wake pipe
+static void io_thread_main()
+{
+	std::vector<ipc_client> clients;
+	std::vector<pollfd> fds;
+	while (running) {
+		fds.clear();
+		fds.push_back({wake_fds[0], POLLIN, 0});
+		fds.push_back({listen_fd, POLLIN, 0});
+		for (const auto &client : clients) {
+			short events = 0;
+			if (client.pending < IPC_MAX_PENDING && client.out.size() < IPC_MAX_UNSENT)
+				events |= POLLIN;
+			if (!client.out.empty())
+				events |= POLLOUT;
+			fds.push_back({client.fd, events, 0});
+		}
+		if (poll(fds.data(), (nfds_t)fds.size(), -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			blog(LOG_WARNING, "[Downstream Keyer] local control poll failed: %d", errno);
+			break;
+		}
+		if (fds[0].revents) {
+			char drain[64];
+			while (read(wake_fds[0], drain, sizeof(drain)) > 0)
+				;
+			if (!running)
+				break;
+		}
+		const size_t polled = clients.size();
+		for (size_t i = polled; i-- > 0;) {
+			const short revents = fds[i + 2].revents;
+			if (!revents)
+				continue;
+			bool ok = true;
+			if (revents & POLLOUT)
+				ok = flush_client(clients[i]);
+			if (ok && (revents & (POLLIN | POLLHUP | POLLERR)))
+				ok = read_client(clients[i]);
+			if (!ok) {
+				close(clients[i].fd);
+				clients.erase(clients.begin() + (long)i);
+			}
+		}
+		collect_responses(clients);
+		for (size_t i = clients.size(); i-- > 0;) {
+			if (!clients[i].out.empty() && !flush_client(clients[i])) {
+				close(clients[i].fd);
+				clients.erase(clients.begin() + (long)i);
+			}
+		}
+		if (fds[1].revents & POLLIN) {
+			int fd = accept(listen_fd, nullptr, nullptr);
+			if (fd >= 0) {
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+				clients.push_back({next_client_id++, fd, {}, {}, 0});
+			}
+		}
+	}
+	for (const auto &client : clients)
+		close(client.fd);
+}
+
+// true when another process is accepting connections on the socket
+static bool socket_in_use(const sockaddr_un &addr)
+{
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return false;
+	const bool in_use = connect(fd, (const sockaddr *)&addr, sizeof(addr)) == 0 || errno == EAGAIN;
+	close(fd);
+	return in_use;
+}
+
+bool StartLocalControl()
+{
+	if (running)
+		return true;
+	dsk_ipc_socket_path(socket_path, sizeof(socket_path));
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+	// only a socket nobody listens on is stale, one owned by another OBS instance is left alone
+	if (socket_in_use(addr)) {
+		blog(LOG_WARNING, "[Downstream Keyer] local control socket %s is in use by another process", socket_path);
+		return false;
+	}
+	unlink(socket_path);
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_fd < 0)
+		return false;
+	if (bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) < 0 || chmod(socket_path, S_IRUSR | S_IWUSR) < 0 ||
+	    listen(listen_fd, 4) < 0 || pipe(wake_fds) < 0) {
+		blog(LOG_WARNING, "[Downstream Keyer] local control could not listen on %s: %d", socket_path, errno);
+		close(listen_fd);
+		listen_fd = -1;
+		unlink(socket_path);
+		return false;
+	}
+	fcntl(wake_fds[0], F_SETFL, fcntl(wake_fds[0], F_GETFL) | O_NONBLOCK);
+	fcntl(wake_fds[1], F_SETFL, fcntl(wake_fds[1], F_GETFL) | O_NONBLOCK);
+	running = true;
+	io_thread = std::thread(io_thread_main);
+	blog(LOG_INFO, "[Downstream Keyer] local control listening on %s", socket_path);
+	return true;
+}
+
+// called on the UI thread, requests still queued for it see running cleared and are dropped
+void StopLocalControl()
+{
+	if (!running)
+		return;
+	running = false;
+	const char wake = 0;
+	if (write(wake_fds[1], &wake, 1) < 0 && errno != EAGAIN)
+		blog(LOG_WARNING, "[Downstream Keyer] local control wake failed: %d", errno);
+	io_thread.join();
+	close(listen_fd);
+	close(wake_fds[0]);
+	close(wake_fds[1]);
+	listen_fd = -1;
+	wake_fds[0] = wake_fds[1] = -1;
+	unlink(socket_path);
+	std::lock_guard<std::mutex> lock(responses_mutex);
+	responses.clear();
+}
+
+bool LocalControlRunning()
+{
+	return running;
+}
+
+#else
+
+bool StartLocalControl()
+{
+	blog(LOG_WARNING, "[Downstream Keyer] local control is only available on Unix domain sockets");
+	return false;
+}
+
+void StopLocalControl() {}
+
+bool LocalControlRunning()
+{
+	return false;
+}
+
+#endif
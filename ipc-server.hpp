@@ -0,0 +1,6 @@
+#pragma once
+
+// Optional local control socket, a dedicated I/O thread reads the requests and the UI thread runs them through the keyer procs
+bool StartLocalControl();
+void StopLocalControl();
+bool LocalControlRunning();
@@ -2,11 +2,16 @@
 #include <stdio.h>
 #include <obs-frontend-api.h>
 #include <util/dstr.h>
+#include <util/threading.h>
 
 struct output_source_context {
 	obs_source_t *source;
 	bool rendering;
+	// view_name, view_handle, view_generation and channel are set on update and read on the video thread
+	pthread_mutex_t view_mutex;
 	char *view_name;
+	uint32_t view_handle;
+	uint64_t view_generation;
 	uint32_t channel;
 	obs_source_t *outputSource;
 	uint32_t width;
@@ -17,10 +22,12 @@ struct output_source_context {
 };
 
 size_t get_view_count();
-const char *get_view_name(size_t idx);
+char *get_view_name(size_t idx);
 obs_view_t *get_view_by_name(const char *view_name);
 obs_canvas_t *get_canvas_by_name(const char *view_name);
-obs_source_t *get_source_from_view(const char *view_name, uint32_t channel);
+uint32_t get_view_handle(const char *view_name);
+uint64_t get_view_generation();
+obs_source_t *get_source_from_view(uint32_t view_handle, uint32_t channel);
 
 static const char *output_source_get_name(void *type_data)
 {
@@ -32,12 +39,16 @@ static void output_source_update(void *data, obs_data_t *settings)
 {
 	struct output_source_context *context = data;
 	const char *view_name = obs_data_get_string(settings, "view");
+	pthread_mutex_lock(&context->view_mutex);
 	if (!context->view_name || strcmp(view_name, context->view_name) != 0) {
 		bfree(context->view_name);
 		context->view_name = bstrdup(view_name);
+		context->view_generation = get_view_generation();
+		context->view_handle = get_view_handle(view_name);
 	}
 
 	context->channel = (uint32_t)obs_data_get_int(settings, "channel");
+	pthread_mutex_unlock(&context->view_mutex);
 	vec4_from_rgba(&context->color, (uint32_t)obs_data_get_int(settings, "color"));
 }
 
@@ -45,6 +56,7 @@ static void *output_source_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct output_source_context *context = bzalloc(sizeof(struct output_source_context));
 	context->source = source;
+	pthread_mutex_init(&context->view_mutex, NULL);
 
 	output_source_update(context, settings);
 	return context;
@@ -58,6 +70,7 @@ static void output_source_destroy(void *data)
 		gs_texrender_destroy(context->render);
 		obs_leave_graphics();
 	}
+	pthread_mutex_destroy(&context->view_mutex);
 	bfree(context->view_name);
 	bfree(context);
 }
@@ -122,8 +135,9 @@ static obs_properties_t *output_source_properties(void *data)
 		obs_property_t *p = obs_properties_add_list(ppts, "view", obs_module_text("View"), OBS_COMBO_TYPE_LIST,
 							    OBS_COMBO_FORMAT_STRING);
 		for (size_t i = 0; i < c; i++) {
-			const char *name = get_view_name(i);
+			char *name = get_view_name(i);
 			obs_property_list_add_string(p, name, name);
+			bfree(name);
 		}
 		obs_property_set_modified_callback2(p, view_changed, data);
 	}
@@ -212,8 +226,25 @@ static void output_source_video_tick(void *data, float seconds)
 {
 	UNUSED_PARAMETER(seconds);
 	struct output_source_context *context = data;
-	obs_source_t *source = strlen(context->view_name) ? get_source_from_view(context->view_name, context->channel)
-							  : obs_get_output_source(context->channel);
+	obs_source_t *source = NULL;
+	pthread_mutex_lock(&context->view_mutex);
+	const bool has_view = context->view_name && strlen(context->view_name);
+	if (has_view) {
+		// only look the view up by name again when views were added or removed since the handle was taken
+		const uint64_t generation = get_view_generation();
+		if (generation != context->view_generation) {
+			context->view_generation = generation;
+			context->view_handle = get_view_handle(context->view_name);
+		}
+	}
+	const uint32_t view_handle = context->view_handle;
+	const uint32_t channel = context->channel;
+	pthread_mutex_unlock(&context->view_mutex);
+	if (has_view) {
+		source = get_source_from_view(view_handle, channel);
+	} else {
+		source = obs_get_output_source(channel);
+	}
 	if (!source) {
 		if (context->outputSource) {
 			context->outputSource = NULL;
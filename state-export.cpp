@@ -0,0 +1,91 @@
+#include "state-export.hpp"
+#include <obs-module.h>
+#include <util/platform.h>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static dsk_state_file *state_file = nullptr;
+static char state_path[512];
+
+bool OpenStateExport()
+{
+	if (state_file)
+		return true;
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	if (!dir || !*dir)
+		dir = "/tmp";
+	snprintf(state_path, sizeof(state_path), "%s/obs-downstream-keyer-%d.state", dir, (int)getpid());
+	// a file left by an earlier process with the same pid is replaced, never followed or reused
+	unlink(state_path);
+	int fd = open(state_path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		blog(LOG_WARNING, "[Downstream Keyer] could not create state export %s: %d", state_path, errno);
+		return false;
+	}
+	if (ftruncate(fd, sizeof(dsk_state_file)) < 0) {
+		blog(LOG_WARNING, "[Downstream Keyer] could not size state export %s: %d", state_path, errno);
+		close(fd);
+		unlink(state_path);
+		return false;
+	}
+	void *map = mmap(nullptr, sizeof(dsk_state_file), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		unlink(state_path);
+		return false;
+	}
+	state_file = static_cast<dsk_state_file *>(map);
+	state_file->version = DSK_STATE_VERSION;
+	__atomic_store_n(&state_file->magic, DSK_STATE_MAGIC, __ATOMIC_RELEASE);
+	blog(LOG_INFO, "[Downstream Keyer] publishing state to %s", state_path);
+	return true;
+}
+
+void CloseStateExport()
+{
+	if (!state_file)
+		return;
+	munmap(state_file, sizeof(dsk_state_file));
+	state_file = nullptr;
+	unlink(state_path);
+}
+
+void WriteStateExport(const std::vector<dsk_state_keyer> &keyers)
+{
+	if (!state_file)
+		return;
+	// single writer on the UI thread, the odd sequence tells readers a snapshot is being written
+	const uint32_t sequence = __atomic_load_n(&state_file->sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&state_file->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	const size_t count = keyers.size() < DSK_STATE_MAX_KEYERS ? keyers.size() : DSK_STATE_MAX_KEYERS;
+	if (count)
+		memcpy(state_file->keyers, keyers.data(), count * sizeof(dsk_state_keyer));
+	state_file->keyer_count = (uint32_t)count;
+	state_file->updated_ns = os_gettime_ns();
+	__atomic_store_n(&state_file->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+#else
+
+bool OpenStateExport()
+{
+	return false;
+}
+
+void CloseStateExport() {}
+
+void WriteStateExport(const std::vector<dsk_state_keyer> &keyers)
+{
+	UNUSED_PARAMETER(keyers);
+}
+
+#endif
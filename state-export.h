@@ -0,0 +1,49 @@
+#pragma once
+/*
+ * Read-only state snapshot of all downstream keyers, published as a memory mapped file
+ * at $XDG_RUNTIME_DIR/obs-downstream-keyer-<pid>.state (or /tmp when unset).
+ *
+ * The writer bumps sequence to an odd value before changing the snapshot and to the next even value after.
+ * Readers copy the snapshot between two loads of sequence and retry when they differ or are odd.
+ *
+ * The snapshot only changes on keyer events, so transition progress is not stored. While phase is
+ * DSK_STATE_TRANSITIONING readers derive it from transition_start_ns (CLOCK_MONOTONIC, as os_gettime_ns)
+ * and transition_duration_ms.
+ */
+
+#include <stdint.h>
+
+#define DSK_STATE_MAGIC 0x304b5344u /* "DSK0" */
+#define DSK_STATE_VERSION 2
+#define DSK_STATE_MAX_KEYERS 64
+#define DSK_STATE_NAME_SIZE 64
+#define DSK_STATE_SCENE_SIZE 128
+
+enum dsk_state_phase {
+	DSK_STATE_IDLE = 0,
+	DSK_STATE_TRANSITIONING = 1,
+};
+
+struct dsk_state_keyer {
+	char view_name[DSK_STATE_NAME_SIZE];
+	char dsk_name[DSK_STATE_NAME_SIZE];
+	char scene[DSK_STATE_SCENE_SIZE];
+	char cued_scene[DSK_STATE_SCENE_SIZE];
+	int32_t channel;
+	uint8_t tie;
+	uint8_t rendering;
+	uint8_t phase;
+	uint8_t transitions_ready;
+	uint32_t transition_duration_ms;
+	uint32_t reserved;
+	uint64_t transition_start_ns;
+};
+
+struct dsk_state_file {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sequence;
+	uint32_t keyer_count;
+	uint64_t updated_ns;
+	struct dsk_state_keyer keyers[DSK_STATE_MAX_KEYERS];
+};
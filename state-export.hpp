@@ -0,0 +1,8 @@
+#pragma once
+#include "state-export.h"
+#include <vector>
+
+// Memory mapped keyer state for external monitors, see state-export.h for the layout and read protocol
+bool OpenStateExport();
+void CloseStateExport();
+void WriteStateExport(const std::vector<dsk_state_keyer> &keyers);
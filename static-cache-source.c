@@ -0,0 +1,319 @@
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/threading.h>
+
+struct static_cache_context {
+	obs_source_t *source;
+	obs_weak_source_t *target;
+	char *target_uuid;
+	uint32_t width;
+	uint32_t height;
+	volatile bool dirty;
+	volatile bool rewire;
+	gs_texrender_t *render;
+
+	/* every source of the target tree, once with connected signals and once by address. members are only compared to
+	 * tell whether an updated source is part of the tree, they are never dereferenced */
+	pthread_mutex_t tree_mutex;
+	DARRAY(obs_weak_source_t *) sources;
+	DARRAY(obs_source_t *) members;
+};
+
+static const char *scene_signals[] = {"reorder", "item_visible", "item_transform"};
+static const char *structure_signals[] = {"item_add", "item_remove", "refresh"};
+static const char *filter_signals[] = {"filter_add", "filter_remove", "reorder_filters"};
+
+#define scene_signal_count (sizeof(scene_signals) / sizeof(scene_signals[0]))
+#define structure_signal_count (sizeof(structure_signals) / sizeof(structure_signals[0]))
+#define filter_signal_count (sizeof(filter_signals) / sizeof(filter_signals[0]))
+
+static const char *static_cache_get_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return obs_module_text("StaticCache");
+}
+
+static void static_cache_invalidate(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	struct static_cache_context *context = data;
+	os_atomic_set_bool(&context->dirty, true);
+}
+
+// the tree changed, the signal connections are rebuilt on the next tick
+static void static_cache_restructure(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	struct static_cache_context *context = data;
+	os_atomic_set_bool(&context->rewire, true);
+	os_atomic_set_bool(&context->dirty, true);
+}
+
+static bool static_cache_is_member(struct static_cache_context *context, obs_source_t *source)
+{
+	for (size_t i = 0; i < context->members.num; i++) {
+		if (context->members.array[i] == source)
+			return true;
+	}
+	return false;
+}
+
+// settings of a source or of a filter on it only matter when the source is part of the target tree
+static void static_cache_source_updated(void *data, calldata_t *cd)
+{
+	struct static_cache_context *context = data;
+	obs_source_t *source = calldata_ptr(cd, "source");
+	if (!source)
+		return;
+	obs_source_t *parent = obs_filter_get_parent(source);
+	pthread_mutex_lock(&context->tree_mutex);
+	const bool member = static_cache_is_member(context, source) || (parent && static_cache_is_member(context, parent));
+	pthread_mutex_unlock(&context->tree_mutex);
+	if (member)
+		os_atomic_set_bool(&context->dirty, true);
+}
+
+static void static_cache_collect(struct static_cache_context *context, obs_source_t *source);
+
+static bool static_cache_collect_item(obs_scene_t *scene, obs_sceneitem_t *item, void *param)
+{
+	UNUSED_PARAMETER(scene);
+	static_cache_collect(param, obs_sceneitem_get_source(item));
+	return true;
+}
+
+// every source of the tree gets the filter signals, nested scenes and groups also get the same signals as the target.
+// the same source can be nested more than once
+static void static_cache_collect(struct static_cache_context *context, obs_source_t *source)
+{
+	if (!source || static_cache_is_member(context, source))
+		return;
+	da_push_back(context->members, &source);
+	signal_handler_t *sh = obs_source_get_signal_handler(source);
+	for (size_t i = 0; i < filter_signal_count; i++)
+		signal_handler_connect(sh, filter_signals[i], static_cache_invalidate, context);
+	obs_weak_source_t *weak = obs_source_get_weak_source(source);
+	da_push_back(context->sources, &weak);
+	obs_scene_t *scene = obs_scene_from_source(source);
+	if (!scene)
+		scene = obs_group_from_source(source);
+	if (!scene)
+		return;
+	for (size_t i = 0; i < scene_signal_count; i++)
+		signal_handler_connect(sh, scene_signals[i], static_cache_invalidate, context);
+	for (size_t i = 0; i < structure_signal_count; i++)
+		signal_handler_connect(sh, structure_signals[i], static_cache_restructure, context);
+	obs_scene_enum_items(scene, static_cache_collect_item, context);
+}
+
+// disconnecting a signal that was never connected is a no-op, so scene signals are dropped from every source
+static void static_cache_disconnect_tree(struct static_cache_context *context)
+{
+	for (size_t i = 0; i < context->sources.num; i++) {
+		obs_source_t *source = obs_weak_source_get_source(context->sources.array[i]);
+		if (source) {
+			signal_handler_t *sh = obs_source_get_signal_handler(source);
+			for (size_t j = 0; j < filter_signal_count; j++)
+				signal_handler_disconnect(sh, filter_signals[j], static_cache_invalidate, context);
+			for (size_t j = 0; j < scene_signal_count; j++)
+				signal_handler_disconnect(sh, scene_signals[j], static_cache_invalidate, context);
+			for (size_t j = 0; j < structure_signal_count; j++)
+				signal_handler_disconnect(sh, structure_signals[j], static_cache_restructure, context);
+			obs_source_release(source);
+		}
+		obs_weak_source_release(context->sources.array[i]);
+	}
+	da_resize(context->sources, 0);
+	da_resize(context->members, 0);
+}
+
+static void static_cache_rewire(struct static_cache_context *context)
+{
+	obs_source_t *target = obs_weak_source_get_source(context->target);
+	pthread_mutex_lock(&context->tree_mutex);
+	static_cache_disconnect_tree(context);
+	if (target)
+		static_cache_collect(context, target);
+	pthread_mutex_unlock(&context->tree_mutex);
+	obs_source_release(target);
+}
+
+static void static_cache_disconnect_target(struct static_cache_context *context)
+{
+	pthread_mutex_lock(&context->tree_mutex);
+	static_cache_disconnect_tree(context);
+	pthread_mutex_unlock(&context->tree_mutex);
+	obs_weak_source_release(context->target);
+	context->target = NULL;
+}
+
+static void static_cache_update(void *data, obs_data_t *settings)
+{
+	struct static_cache_context *context = data;
+	const char *uuid = obs_data_get_string(settings, "source");
+	if (context->target_uuid && strcmp(uuid, context->target_uuid) == 0)
+		return;
+	bfree(context->target_uuid);
+	context->target_uuid = bstrdup(uuid);
+
+	static_cache_disconnect_target(context);
+	obs_source_t *target = obs_get_source_by_uuid(uuid);
+	if (target) {
+		context->target = obs_source_get_weak_source(target);
+		obs_source_release(target);
+	}
+	static_cache_rewire(context);
+	os_atomic_set_bool(&context->dirty, true);
+}
+
+static void *static_cache_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct static_cache_context *context = bzalloc(sizeof(struct static_cache_context));
+	context->source = source;
+	context->dirty = true;
+	pthread_mutex_init(&context->tree_mutex, NULL);
+	da_init(context->sources);
+	da_init(context->members);
+	signal_handler_connect(obs_get_signal_handler(), "source_update", static_cache_source_updated, context);
+
+	static_cache_update(context, settings);
+	return context;
+}
+
+static void static_cache_destroy(void *data)
+{
+	struct static_cache_context *context = data;
+	signal_handler_disconnect(obs_get_signal_handler(), "source_update", static_cache_source_updated, context);
+	static_cache_disconnect_target(context);
+	if (context->render) {
+		obs_enter_graphics();
+		gs_texrender_destroy(context->render);
+		obs_leave_graphics();
+	}
+	da_free(context->sources);
+	da_free(context->members);
+	pthread_mutex_destroy(&context->tree_mutex);
+	bfree(context->target_uuid);
+	bfree(context);
+}
+
+static void static_cache_activate(void *data)
+{
+	struct static_cache_context *context = data;
+	os_atomic_set_bool(&context->dirty, true);
+}
+
+static void static_cache_enum_sources(void *data, obs_source_enum_proc_t enum_callback, void *param)
+{
+	struct static_cache_context *context = data;
+	obs_source_t *target = obs_weak_source_get_source(context->target);
+	if (!target)
+		return;
+	enum_callback(context->source, target, param);
+	obs_source_release(target);
+}
+
+static void static_cache_video_render(void *data, gs_effect_t *effect)
+{
+	UNUSED_PARAMETER(effect);
+	struct static_cache_context *context = data;
+	if (!context->render)
+		return;
+	gs_texture_t *tex = gs_texrender_get_texture(context->render);
+	if (!tex)
+		return;
+	// the cache holds linear colour in an sRGB texture, drawn the way obs_source_draw does
+	const bool linear_srgb = gs_get_linear_srgb();
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(linear_srgb);
+	effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+	if (linear_srgb)
+		gs_effect_set_texture_srgb(image, tex);
+	else
+		gs_effect_set_texture(image, tex);
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(tex, 0, context->width, context->height);
+	gs_enable_framebuffer_srgb(previous);
+}
+
+static uint32_t static_cache_getwidth(void *data)
+{
+	struct static_cache_context *context = data;
+	return context->width;
+}
+
+static uint32_t static_cache_getheight(void *data)
+{
+	struct static_cache_context *context = data;
+	return context->height;
+}
+
+static void static_cache_video_tick(void *data, float seconds)
+{
+	UNUSED_PARAMETER(seconds);
+	struct static_cache_context *context = data;
+	if (os_atomic_exchange_bool(&context->rewire, false))
+		static_cache_rewire(context);
+	obs_source_t *target = obs_weak_source_get_source(context->target);
+	if (!target)
+		return;
+	const uint32_t width = obs_source_get_width(target);
+	const uint32_t height = obs_source_get_height(target);
+	if (width != context->width || height != context->height) {
+		context->width = width;
+		context->height = height;
+		os_atomic_set_bool(&context->dirty, true);
+	}
+	if (!os_atomic_exchange_bool(&context->dirty, false) && context->render) {
+		obs_source_release(target);
+		return;
+	}
+
+	obs_enter_graphics();
+	if (!context->render) {
+		context->render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	} else {
+		gs_texrender_reset(context->render);
+	}
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (gs_texrender_begin(context->render, context->width, context->height)) {
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)context->width, 0.0f, (float)context->height, -100.0f, 100.0f);
+
+		const bool previous = gs_framebuffer_srgb_enabled();
+		const bool previous_linear = gs_set_linear_srgb(true);
+		gs_enable_framebuffer_srgb(true);
+		obs_source_video_render(target);
+		gs_enable_framebuffer_srgb(previous);
+		gs_set_linear_srgb(previous_linear);
+
+		gs_texrender_end(context->render);
+	}
+	gs_blend_state_pop();
+	obs_leave_graphics();
+	obs_source_release(target);
+}
+
+struct obs_source_info static_cache_source_info = {
+	.id = "dsk_static_cache",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_CAP_DISABLED,
+	.get_name = static_cache_get_name,
+	.create = static_cache_create,
+	.destroy = static_cache_destroy,
+	.load = static_cache_update,
+	.update = static_cache_update,
+	.activate = static_cache_activate,
+	.enum_active_sources = static_cache_enum_sources,
+	.video_render = static_cache_video_render,
+	.video_tick = static_cache_video_tick,
+	.get_width = static_cache_getwidth,
+	.get_height = static_cache_getheight,
+	.icon_type = OBS_ICON_TYPE_UNKNOWN,
+};
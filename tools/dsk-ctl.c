@@ -0,0 +1,208 @@
+/*
+ * Minimal client for the downstream keyer local control socket.
+ *
+ *   dsk-ctl [-v view] select <dsk> <scene>
+ *   dsk-ctl [-v view] cue <dsk> <scene>
+ *   dsk-ctl [-v view] take <dsk>
+ *   dsk-ctl [-v view] tie <dsk> on|off
+ *   dsk-ctl [-v view] transition <dsk> <transition> <duration> [match|show|hide]
+ *   dsk-ctl [-v view] state <dsk>
+ *   dsk-ctl [-v view] batch    reads one command per line from stdin, fields separated by tabs
+ */
+
+#include "ipc-protocol.h"
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_ARGS 8
+
+static bool encode_command(struct dsk_ipc_buffer *buf, const char *view, int argc, char **argv)
+{
+	if (argc < 2)
+		return false;
+	const char *cmd = argv[0];
+	const char *dsk = argv[1];
+	if (strcmp(cmd, "select") == 0 && argc == 3) {
+		return dsk_ipc_put_u8(buf, DSK_IPC_SELECT_SCENE) && dsk_ipc_put_str(buf, view) && dsk_ipc_put_str(buf, dsk) &&
+		       dsk_ipc_put_str(buf, argv[2]);
+	} else if (strcmp(cmd, "cue") == 0 && argc == 3) {
+		return dsk_ipc_put_u8(buf, DSK_IPC_CUE_SCENE) && dsk_ipc_put_str(buf, view) && dsk_ipc_put_str(buf, dsk) &&
+		       dsk_ipc_put_str(buf, argv[2]);
+	} else if (strcmp(cmd, "take") == 0 && argc == 2) {
+		return dsk_ipc_put_u8(buf, DSK_IPC_TAKE) && dsk_ipc_put_str(buf, view) && dsk_ipc_put_str(buf, dsk);
+	} else if (strcmp(cmd, "tie") == 0 && argc == 3) {
+		return dsk_ipc_put_u8(buf, DSK_IPC_SET_TIE) && dsk_ipc_put_str(buf, view) && dsk_ipc_put_str(buf, dsk) &&
+		       dsk_ipc_put_u8(buf, strcmp(argv[2], "on") == 0);
+	} else if (strcmp(cmd, "transition") == 0 && (argc == 4 || argc == 5)) {
+		uint8_t type = 0;
+		if (argc == 5)
+			type = strcmp(argv[4], "show") == 0 ? 1 : strcmp(argv[4], "hide") == 0 ? 2 : 0;
+		return dsk_ipc_put_u8(buf, DSK_IPC_SET_TRANSITION) && dsk_ipc_put_str(buf, view) && dsk_ipc_put_str(buf, dsk) &&
+		       dsk_ipc_put_str(buf, argv[2]) && dsk_ipc_put_u32(buf, (uint32_t)strtoul(argv[3], NULL, 10)) &&
+		       dsk_ipc_put_u8(buf, type);
+	} else if (strcmp(cmd, "state") == 0 && argc == 2) {
+		return dsk_ipc_put_u8(buf, DSK_IPC_GET_STATE) && dsk_ipc_put_str(buf, view) && dsk_ipc_put_str(buf, dsk);
+	}
+	return false;
+}
+
+static int print_response(struct dsk_ipc_buffer *res, uint8_t op)
+{
+	uint8_t status = DSK_IPC_BAD_REQUEST;
+	if (!dsk_ipc_get_u8(res, &status))
+		return 1;
+	if (status != DSK_IPC_OK) {
+		printf("%s\n", status == DSK_IPC_FAILED ? "failed" : "bad request");
+		return 1;
+	}
+	if (op != DSK_IPC_GET_STATE) {
+		printf("ok\n");
+		return 0;
+	}
+	char scene[512], cued[512], phase[64];
+	uint32_t channel = 0;
+	uint16_t progress = 0;
+	uint8_t tie = 0, rendering = 0, ready = 0;
+	if (!dsk_ipc_get_str(res, scene, sizeof(scene)) || !dsk_ipc_get_str(res, cued, sizeof(cued)) ||
+	    !dsk_ipc_get_u32(res, &channel) || !dsk_ipc_get_u8(res, &tie) || !dsk_ipc_get_u8(res, &rendering) ||
+	    !dsk_ipc_get_str(res, phase, sizeof(phase)) || !dsk_ipc_get_u16(res, &progress) || !dsk_ipc_get_u8(res, &ready))
+		return 1;
+	printf("scene=%s cued=%s channel=%u tie=%u rendering=%u phase=%s progress=%.3f ready=%u\n", scene, cued, channel, tie,
+	       rendering, phase, progress / 1000.0, ready);
+	return 0;
+}
+
+static bool write_all(int fd, const uint8_t *data, size_t size)
+{
+	while (size) {
+		ssize_t sent = write(fd, data, size);
+		if (sent <= 0)
+			return false;
+		data += sent;
+		size -= (size_t)sent;
+	}
+	return true;
+}
+
+static bool read_all(int fd, uint8_t *data, size_t size)
+{
+	while (size) {
+		ssize_t received = read(fd, data, size);
+		if (received <= 0)
+			return false;
+		data += received;
+		size -= (size_t)received;
+	}
+	return true;
+}
+
+static int split_line(char *line, char **args)
+{
+	int count = 0;
+	char *save = NULL;
+	for (char *tok = strtok_r(line, "\t\r\n", &save); tok && count < MAX_ARGS; tok = strtok_r(NULL, "\t\r\n", &save))
+		args[count++] = tok;
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	const char *view = "";
+	int arg = 1;
+	if (argc > 2 && strcmp(argv[1], "-v") == 0) {
+		view = argv[2];
+		arg = 3;
+	}
+	if (arg >= argc) {
+		fprintf(stderr, "usage: %s [-v view] select|cue|take|tie|transition|state|batch ...\n", argv[0]);
+		return 2;
+	}
+
+	static uint8_t frame[DSK_IPC_MAX_FRAME];
+	struct dsk_ipc_buffer req = {frame + 4, sizeof(frame) - 4, 0};
+	uint8_t ops[UINT16_MAX];
+	uint16_t batch_count = 0;
+	bool batch = strcmp(argv[arg], "batch") == 0;
+	if (batch) {
+		char line[1024];
+		char *args[MAX_ARGS];
+		dsk_ipc_put_u8(&req, DSK_IPC_BATCH);
+		const size_t count_pos = req.pos;
+		dsk_ipc_put_u16(&req, 0);
+		while (fgets(line, sizeof(line), stdin) && batch_count < UINT16_MAX) {
+			int n = split_line(line, args);
+			if (!n)
+				continue;
+			const size_t len_pos = req.pos;
+			if (!dsk_ipc_put_u32(&req, 0) || !encode_command(&req, view, n, args)) {
+				fprintf(stderr, "invalid command: %s\n", args[0]);
+				return 2;
+			}
+			struct dsk_ipc_buffer patch = {req.data + len_pos, 4, 0};
+			dsk_ipc_put_u32(&patch, (uint32_t)(req.pos - len_pos - 4));
+			ops[batch_count++] = req.data[len_pos + 4];
+		}
+		struct dsk_ipc_buffer patch = {req.data + count_pos, 2, 0};
+		dsk_ipc_put_u16(&patch, batch_count);
+	} else if (!encode_command(&req, view, argc - arg, argv + arg)) {
+		fprintf(stderr, "invalid command\n");
+		return 2;
+	}
+	struct dsk_ipc_buffer prefix = {frame, 4, 0};
+	dsk_ipc_put_u32(&prefix, (uint32_t)req.pos);
+	const uint8_t op = req.data[0];
+
+	struct sockaddr_un addr = {0};
+	addr.sun_family = AF_UNIX;
+	dsk_ipc_socket_path(addr.sun_path, sizeof(addr.sun_path));
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		fprintf(stderr, "could not connect to %s\n", addr.sun_path);
+		return 1;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	uint32_t len = 0;
+	if (!write_all(fd, frame, req.pos + 4) || !read_all(fd, frame, 4)) {
+		close(fd);
+		return 1;
+	}
+	struct dsk_ipc_buffer header = {frame, 4, 0};
+	dsk_ipc_get_u32(&header, &len);
+	if (len > sizeof(frame) || !read_all(fd, frame, len)) {
+		close(fd);
+		return 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	close(fd);
+
+	struct dsk_ipc_buffer res = {frame, len, 0};
+	int result = 0;
+	if (batch) {
+		uint8_t status = 0;
+		uint16_t count = 0;
+		if (!dsk_ipc_get_u8(&res, &status) || status != DSK_IPC_OK || !dsk_ipc_get_u16(&res, &count))
+			return 1;
+		for (uint16_t i = 0; i < count && i < batch_count; i++) {
+			uint32_t sub_len = 0;
+			if (!dsk_ipc_get_u32(&res, &sub_len) || res.pos + sub_len > res.size)
+				return 1;
+			struct dsk_ipc_buffer sub = {res.data + res.pos, sub_len, 0};
+			res.pos += sub_len;
+			result |= print_response(&sub, ops[i]);
+		}
+		if (count < batch_count) {
+			fprintf(stderr, "only %u of %u requests ran, the response did not fit in one frame\n", count, batch_count);
+			result = 1;
+		}
+	} else {
+		result = print_response(&res, op);
+	}
+	fprintf(stderr, "round trip %.3f ms\n",
+		(double)(end.tv_sec - start.tv_sec) * 1000.0 + (double)(end.tv_nsec - start.tv_nsec) / 1000000.0);
+	return result;
+}
@@ -0,0 +1,392 @@
+/*
+ * Load generator for the downstream keyer vendor requests.
+ *
+ * Loaded as a second OBS module, it stands in for obs-websocket: it answers obs_websocket_api_get_ph with its own
+ * proc handler, so the downstream keyer registers its vendor requests here instead. Do not install it next to the
+ * real obs-websocket, both would register the same proc.
+ *
+ * The run is started from Tools > "Downstream Keyer load test", or at startup when DSK_LOADGEN_AUTORUN is set.
+ *   DSK_LOADGEN_THREADS  request threads (default 4)
+ *   DSK_LOADGEN_SECONDS  duration of the run (default 5)
+ *   DSK_LOADGEN_VIEW     view or canvas name of the dock under test (default: main dock)
+ *   DSK_LOADGEN_DSK      keyer under test (default: first keyer of that dock)
+ *   DSK_LOADGEN_MODE     "save" times get_downstream_keyers, which serializes the dock like a frontend save, from a
+ *                        single thread instead of running the mixed request load
+ * Throughput, latency percentiles, failed requests, dsk_scene_changed events and the final state check are logged.
+ */
+
+#include <obs-module.h>
+#include <obs-frontend-api.h>
+#include <util/platform.h>
+#include "obs-websocket-api.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+OBS_DECLARE_MODULE()
+
+struct loadgen_vendor {
+	std::string name;
+	std::map<std::string, obs_websocket_request_callback> requests;
+};
+
+static proc_handler_t *loadgen_ph = nullptr;
+static std::mutex vendors_mutex;
+static std::vector<loadgen_vendor *> vendors;
+static std::atomic<uint64_t> scene_changed_events = 0;
+static std::atomic<uint64_t> other_events = 0;
+static std::atomic<bool> running = false;
+static std::thread run_thread;
+
+static int env_int(const char *name, int def)
+{
+	const char *value = getenv(name);
+	return value && *value ? atoi(value) : def;
+}
+
+static const char *env_string(const char *name, const char *def)
+{
+	const char *value = getenv(name);
+	return value ? value : def;
+}
+
+/* ------------------------- obs-websocket stand-in ------------------------- */
+
+static void get_ph(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	calldata_set_ptr(cd, "ph", loadgen_ph);
+}
+
+static void get_api_version(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	calldata_set_int(cd, "version", OBS_WEBSOCKET_API_VERSION);
+}
+
+static void vendor_register(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	auto vendor = new loadgen_vendor;
+	vendor->name = calldata_string(cd, "name");
+	std::lock_guard<std::mutex> lock(vendors_mutex);
+	vendors.push_back(vendor);
+	calldata_set_ptr(cd, "vendor", vendor);
+}
+
+static void vendor_request_register(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	auto vendor = static_cast<loadgen_vendor *>(calldata_ptr(cd, "vendor"));
+	auto cb = static_cast<obs_websocket_request_callback *>(calldata_ptr(cd, "callback"));
+	const char *type = calldata_string(cd, "type");
+	if (!vendor || !cb || !type) {
+		calldata_set_bool(cd, "success", false);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(vendors_mutex);
+	vendor->requests[type] = *cb;
+	calldata_set_bool(cd, "success", true);
+}
+
+static void vendor_request_unregister(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	auto vendor = static_cast<loadgen_vendor *>(calldata_ptr(cd, "vendor"));
+	const char *type = calldata_string(cd, "type");
+	std::lock_guard<std::mutex> lock(vendors_mutex);
+	calldata_set_bool(cd, "success", vendor && type && vendor->requests.erase(type) > 0);
+}
+
+static void vendor_event_emit(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	const char *type = calldata_string(cd, "type");
+	if (type && strcmp(type, "dsk_scene_changed") == 0)
+		scene_changed_events++;
+	else
+		other_events++;
+	calldata_set_bool(cd, "success", true);
+}
+
+/* ------------------------------ request driver ----------------------------- */
+
+static bool find_request(const char *type, obs_websocket_request_callback *cb)
+{
+	std::lock_guard<std::mutex> lock(vendors_mutex);
+	for (auto vendor : vendors) {
+		if (vendor->name != "downstream-keyer")
+			continue;
+		auto it = vendor->requests.find(type);
+		if (it == vendor->requests.end())
+			return false;
+		*cb = it->second;
+		return true;
+	}
+	return false;
+}
+
+// calls a vendor request the way an obs-websocket worker thread does, returns false on failure
+static bool call_request(const char *type, obs_data_t *request, obs_data_t **response_out = nullptr)
+{
+	obs_websocket_request_callback cb;
+	if (!find_request(type, &cb))
+		return false;
+	obs_data_t *response = obs_data_create();
+	cb.callback(request, response, cb.priv_data);
+	const bool success = !obs_data_has_user_value(response, "success") || obs_data_get_bool(response, "success");
+	if (response_out)
+		*response_out = response;
+	else
+		obs_data_release(response);
+	return success;
+}
+
+struct thread_result {
+	std::vector<uint64_t> latencies;
+	uint64_t failures = 0;
+	std::vector<std::string> addedScenes;
+};
+
+static std::vector<std::string> list_scenes()
+{
+	std::vector<std::string> names;
+	obs_frontend_source_list scenes = {};
+	obs_frontend_get_scenes(&scenes);
+	for (size_t i = 0; i < scenes.sources.num; i++)
+		names.emplace_back(obs_source_get_name(scenes.sources.array[i]));
+	obs_frontend_source_list_free(&scenes);
+	return names;
+}
+
+static std::string first_keyer(const std::string &view)
+{
+	obs_data_t *request = obs_data_create();
+	obs_data_set_string(request, "view_name", view.c_str());
+	obs_data_t *response = nullptr;
+	call_request("get_downstream_keyers", request, &response);
+	obs_data_release(request);
+	std::string name;
+	if (!response)
+		return name;
+	const std::string key = view.empty() ? "downstream_keyers" : view + "_downstream_keyers";
+	obs_data_array_t *keyers = obs_data_get_array(response, key.c_str());
+	obs_data_t *keyer = keyers ? obs_data_array_item(keyers, 0) : nullptr;
+	if (keyer)
+		name = obs_data_get_string(keyer, "name");
+	obs_data_release(keyer);
+	obs_data_array_release(keyers);
+	obs_data_release(response);
+	return name;
+}
+
+static void request_thread(const std::string &view, const std::string &dsk, const std::vector<std::string> &scenes,
+			   uint64_t deadline, unsigned int seed, thread_result *result)
+{
+	static const char *types[] = {"dsk_select_scene", "dsk_add_scene", "dsk_set_tie", "get_downstream_keyers"};
+	for (uint64_t n = seed; os_gettime_ns() < deadline; n++) {
+		const char *type = types[n % 4];
+		const std::string &scene = scenes[(n / 4) % scenes.size()];
+		obs_data_t *request = obs_data_create();
+		obs_data_set_string(request, "view_name", view.c_str());
+		obs_data_set_string(request, "dsk_name", dsk.c_str());
+		obs_data_set_string(request, "scene", scene.c_str());
+		obs_data_set_bool(request, "tie", (n / 4) % 2 == 0);
+		const uint64_t start = os_gettime_ns();
+		const bool success = call_request(type, request);
+		result->latencies.push_back(os_gettime_ns() - start);
+		obs_data_release(request);
+		if (!success)
+			result->failures++;
+		else if (type == types[1])
+			result->addedScenes.push_back(scene);
+	}
+}
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, double p)
+{
+	if (sorted.empty())
+		return 0;
+	size_t idx = (size_t)(p * (double)(sorted.size() - 1));
+	return sorted[idx];
+}
+
+// after the run one more select and tie are issued from a single thread and must be what dsk_get_state reports
+static bool check_final_state(const std::string &view, const std::string &dsk, const std::string &scene,
+			      const std::vector<std::string> &added)
+{
+	obs_data_t *request = obs_data_create();
+	obs_data_set_string(request, "view_name", view.c_str());
+	obs_data_set_string(request, "dsk_name", dsk.c_str());
+	obs_data_set_string(request, "scene", scene.c_str());
+	obs_data_set_bool(request, "tie", true);
+	bool ok = call_request("dsk_select_scene", request) && call_request("dsk_set_tie", request);
+	obs_data_t *state = nullptr;
+	ok = call_request("dsk_get_state", request, &state) && ok;
+	if (state) {
+		if (scene != obs_data_get_string(state, "scene") || !obs_data_get_bool(state, "tie")) {
+			blog(LOG_WARNING, "[dsk-loadgen] final state mismatch: scene '%s' tie %d, expected '%s' tie 1",
+			     obs_data_get_string(state, "scene"), obs_data_get_bool(state, "tie"), scene.c_str());
+			ok = false;
+		}
+		obs_data_release(state);
+	}
+	obs_data_t *keyer = nullptr;
+	call_request("get_downstream_keyer", request, &keyer);
+	obs_data_release(request);
+	if (keyer) {
+		std::vector<std::string> listed;
+		obs_data_array_t *array = obs_data_get_array(keyer, "scenes");
+		const size_t count = obs_data_array_count(array);
+		for (size_t i = 0; i < count; i++) {
+			obs_data_t *item = obs_data_array_item(array, i);
+			listed.emplace_back(obs_data_get_string(item, "name"));
+			obs_data_release(item);
+		}
+		obs_data_array_release(array);
+		obs_data_release(keyer);
+		for (const auto &name : added) {
+			if (std::find(listed.begin(), listed.end(), name) == listed.end()) {
+				blog(LOG_WARNING, "[dsk-loadgen] added scene '%s' missing from the keyer", name.c_str());
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
+
+static void run_save_benchmark(const std::string &view)
+{
+	const int seconds = std::max(env_int("DSK_LOADGEN_SECONDS", 5), 1);
+	const uint64_t deadline = os_gettime_ns() + (uint64_t)seconds * 1000000000ULL;
+	std::vector<uint64_t> latencies;
+	size_t size = 0;
+	obs_data_t *request = obs_data_create();
+	obs_data_set_string(request, "view_name", view.c_str());
+	while (os_gettime_ns() < deadline) {
+		obs_data_t *response = nullptr;
+		const uint64_t start = os_gettime_ns();
+		call_request("get_downstream_keyers", request, &response);
+		latencies.push_back(os_gettime_ns() - start);
+		if (response) {
+			const char *json = obs_data_get_json(response);
+			size = json ? strlen(json) : 0;
+			obs_data_release(response);
+		}
+	}
+	obs_data_release(request);
+	std::sort(latencies.begin(), latencies.end());
+	blog(LOG_INFO, "[dsk-loadgen] %zu saves of '%s' (%zu bytes), p50 %.3f ms p99 %.3f ms max %.3f ms", latencies.size(),
+	     view.c_str(), size, (double)percentile(latencies, 0.5) / 1000000.0,
+	     (double)percentile(latencies, 0.99) / 1000000.0, (double)percentile(latencies, 1.0) / 1000000.0);
+	running = false;
+}
+
+static void run_load_test()
+{
+	const std::string view = env_string("DSK_LOADGEN_VIEW", "");
+	if (strcmp(env_string("DSK_LOADGEN_MODE", ""), "save") == 0) {
+		run_save_benchmark(view);
+		return;
+	}
+	std::string dsk = env_string("DSK_LOADGEN_DSK", "");
+	if (dsk.empty())
+		dsk = first_keyer(view);
+	const std::vector<std::string> scenes = list_scenes();
+	if (dsk.empty() || scenes.empty()) {
+		blog(LOG_WARNING, "[dsk-loadgen] nothing to test, keyer '%s', %d scenes", dsk.c_str(), (int)scenes.size());
+		running = false;
+		return;
+	}
+	const int threads = std::max(env_int("DSK_LOADGEN_THREADS", 4), 1);
+	const int seconds = std::max(env_int("DSK_LOADGEN_SECONDS", 5), 1);
+	blog(LOG_INFO, "[dsk-loadgen] %d threads for %d s against keyer '%s' in '%s' with %d scenes", threads, seconds,
+	     dsk.c_str(), view.c_str(), (int)scenes.size());
+
+	const uint64_t eventsBefore = scene_changed_events;
+	const uint64_t start = os_gettime_ns();
+	const uint64_t deadline = start + (uint64_t)seconds * 1000000000ULL;
+	std::vector<thread_result> results((size_t)threads);
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; i++)
+		workers.emplace_back(request_thread, view, dsk, scenes, deadline, (unsigned int)i, &results[(size_t)i]);
+	for (auto &worker : workers)
+		worker.join();
+	const double elapsed = (double)(os_gettime_ns() - start) / 1000000000.0;
+
+	std::vector<uint64_t> latencies;
+	std::vector<std::string> added;
+	uint64_t failures = 0;
+	for (const auto &result : results) {
+		latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+		added.insert(added.end(), result.addedScenes.begin(), result.addedScenes.end());
+		failures += result.failures;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	const bool consistent = check_final_state(view, dsk, scenes.front(), added);
+	blog(LOG_INFO,
+	     "[dsk-loadgen] %zu requests in %.2f s (%.0f/s), %llu failed, latency p50 %.3f ms p99 %.3f ms p99.9 %.3f ms max %.3f ms, "
+	     "%llu dsk_scene_changed events, final state %s",
+	     latencies.size(), elapsed, (double)latencies.size() / elapsed, (unsigned long long)failures,
+	     (double)percentile(latencies, 0.5) / 1000000.0, (double)percentile(latencies, 0.99) / 1000000.0,
+	     (double)percentile(latencies, 0.999) / 1000000.0, (double)percentile(latencies, 1.0) / 1000000.0,
+	     (unsigned long long)(scene_changed_events - eventsBefore), consistent ? "consistent" : "INCONSISTENT");
+	running = false;
+}
+
+// requests must come from threads other than the UI thread, the plugin serializes them onto it
+static void start_load_test(void *data)
+{
+	UNUSED_PARAMETER(data);
+	if (running.exchange(true))
+		return;
+	if (run_thread.joinable())
+		run_thread.join();
+	run_thread = std::thread(run_load_test);
+}
+
+static void frontend_event(enum obs_frontend_event event, void *data)
+{
+	UNUSED_PARAMETER(data);
+	if (event == OBS_FRONTEND_EVENT_FINISHED_LOADING && getenv("DSK_LOADGEN_AUTORUN"))
+		start_load_test(nullptr);
+}
+
+bool obs_module_load()
+{
+	loadgen_ph = proc_handler_create();
+	proc_handler_add(loadgen_ph, "void get_api_version(out int version)", get_api_version, nullptr);
+	proc_handler_add(loadgen_ph, "void vendor_register(in string name, out ptr vendor)", vendor_register, nullptr);
+	proc_handler_add(loadgen_ph,
+			 "void vendor_request_register(in ptr vendor, in string type, in ptr callback, out bool success)",
+			 vendor_request_register, nullptr);
+	proc_handler_add(loadgen_ph, "void vendor_request_unregister(in ptr vendor, in string type, out bool success)",
+			 vendor_request_unregister, nullptr);
+	proc_handler_add(loadgen_ph, "void vendor_event_emit(in ptr vendor, in string type, in ptr data, out bool success)",
+			 vendor_event_emit, nullptr);
+	proc_handler_add(obs_get_proc_handler(), "void obs_websocket_api_get_ph(out ptr ph)", get_ph, nullptr);
+
+	obs_frontend_add_tools_menu_item("Downstream Keyer load test", start_load_test, nullptr);
+	obs_frontend_add_event_callback(frontend_event, nullptr);
+	return true;
+}
+
+void obs_module_unload()
+{
+	obs_frontend_remove_event_callback(frontend_event, nullptr);
+	if (run_thread.joinable())
+		run_thread.join();
+	proc_handler_destroy(loadgen_ph);
+	loadgen_ph = nullptr;
+	std::lock_guard<std::mutex> lock(vendors_mutex);
+	for (auto vendor : vendors)
+		delete vendor;
+	vendors.clear();
+}
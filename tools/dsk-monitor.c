@@ -0,0 +1,102 @@
+/*
+ * Reference reader for the downstream keyer state export.
+ *
+ *   dsk-monitor <state file>        print one consistent snapshot
+ *   dsk-monitor -w <state file>     print every new snapshot
+ */
+
+#include "state-export.h"
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint32_t read_snapshot(const struct dsk_state_file *file, struct dsk_state_file *snapshot)
+{
+	for (;;) {
+		uint32_t before = __atomic_load_n(&file->sequence, __ATOMIC_ACQUIRE);
+		if (before & 1)
+			continue;
+		memcpy(snapshot, file, sizeof(*snapshot));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&file->sequence, __ATOMIC_RELAXED) == before)
+			return before;
+	}
+}
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* progress is not stored in the export, it follows from the start time and duration of the running transition */
+static double transition_progress(const struct dsk_state_keyer *k)
+{
+	if (k->phase != DSK_STATE_TRANSITIONING)
+		return 1.0;
+	if (!k->transition_duration_ms || !k->transition_start_ns)
+		return 0.0;
+	const uint64_t now = monotonic_ns();
+	const double progress = now > k->transition_start_ns
+					? (double)(now - k->transition_start_ns) / ((double)k->transition_duration_ms * 1000000.0)
+					: 0.0;
+	return progress < 1.0 ? progress : 1.0;
+}
+
+static void print_snapshot(const struct dsk_state_file *snapshot)
+{
+	printf("sequence %u, %u keyers\n", snapshot->sequence, snapshot->keyer_count);
+	for (uint32_t i = 0; i < snapshot->keyer_count && i < DSK_STATE_MAX_KEYERS; i++) {
+		const struct dsk_state_keyer *k = &snapshot->keyers[i];
+		printf("  [%s] %s channel %d scene '%s' cued '%s' tie %u rendering %u %s %.3f%s\n", k->view_name, k->dsk_name,
+		       k->channel, k->scene, k->cued_scene, k->tie, k->rendering,
+		       k->phase == DSK_STATE_TRANSITIONING ? "transitioning" : "idle", transition_progress(k),
+		       k->transitions_ready ? " ready" : "");
+	}
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	bool watch = argc > 2 && strcmp(argv[1], "-w") == 0;
+	const char *path = argv[watch ? 2 : 1];
+	if (argc < 2 || !path) {
+		fprintf(stderr, "usage: %s [-w] <state file>\n", argv[0]);
+		return 2;
+	}
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "could not open %s\n", path);
+		return 1;
+	}
+	const struct dsk_state_file *file = mmap(NULL, sizeof(struct dsk_state_file), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (file == MAP_FAILED || __atomic_load_n(&file->magic, __ATOMIC_ACQUIRE) != DSK_STATE_MAGIC ||
+	    file->version != DSK_STATE_VERSION) {
+		fprintf(stderr, "%s is not a downstream keyer state file\n", path);
+		return 1;
+	}
+
+	static struct dsk_state_file snapshot;
+	uint32_t last = read_snapshot(file, &snapshot);
+	print_snapshot(&snapshot);
+	while (watch) {
+		const struct timespec delay = {0, 20 * 1000 * 1000};
+		nanosleep(&delay, NULL);
+		bool transitioning = false;
+		for (uint32_t i = 0; i < snapshot.keyer_count && i < DSK_STATE_MAX_KEYERS; i++)
+			transitioning |= snapshot.keyers[i].phase == DSK_STATE_TRANSITIONING;
+		// keep printing while a transition runs so its progress can be followed
+		if (!transitioning && __atomic_load_n(&file->sequence, __ATOMIC_ACQUIRE) == last)
+			continue;
+		last = read_snapshot(file, &snapshot);
+		print_snapshot(&snapshot);
+	}
+	return 0;
+}